@@ -15,26 +15,66 @@
 #include "ImageData.h"
 #include "AgedWindow.h"
 #include "PEventControlWindow.h"
-#include "TStoreEvent.hh"
-#include "AgFlow.h"
-#include "TStoreHelix.hh" // TEMPORARY
+#include "AgedEvent.h"
+#include "PEventPreparer.h"
+#include "PSnapshotFile.h"
+#include "PEventHistory.h"
+#include "PThreadPool.h"
 
 #define AnyModMask          (Mod1Mask | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask)
 
 Aged::Aged()
 {
     Printf((char *)"Version " AGED_VERSION "\n");
+
+    // Xlib must be initialized for threads before the display is opened
+    // since the X event loop runs in its own thread
+    XInitThreads();
 /*
 ** Create main window and menus
 */
     fWindow = new AgedWindow(1);
     fData = fWindow->GetData();
+/*
+** Create the event preparer, and start the X event loop thread
+*/
+    fPreparer = new PEventPreparer(fData, fData->prefetch, fData->submit_policy);
+    fData->mPreparer = fPreparer;
+    HitScale scale;
+    getHitScale(fData, &scale);
+    fPreparer->SetScale(&scale);
+/*
+** Create the worker threads for transforming and colouring hits
+*/
+    fThreadPool = new PThreadPool(fData->threads, fData->parallel_hits);
+    fData->mThreadPool = fThreadPool;
+
+    fRecorder = NULL;
+    fQuit = 0;
+    fThreadOK = (pthread_create(&fThread, NULL, EventLoop, this) == 0);
+    if (!fThreadOK) {
+        Printf("Error creating X event thread\n");
+        fPreparer->Stop();
+    }
 }
 
 Aged::~Aged()
 {
-    delete fWindow;
+    // stop the X event loop
+    if (fThreadOK) {
+        fQuit = 1;
+        fPreparer->Wake();
+        pthread_join(fThread, NULL);
+    }
+    // (the main window is already gone if it was closed by the user)
+    if (fData->mMainWindow) delete fWindow;
     fWindow = NULL;
+    delete fPreparer;
+    fPreparer = NULL;
+    delete fThreadPool;
+    fThreadPool = NULL;
+    delete fRecorder;
+    fRecorder = NULL;
 }
 
 // dispatchEvent - dispatch the X event (PH 03/25/00)
@@ -101,176 +141,131 @@ static void dispatchEvent(XEvent *event)
     XtDispatchEvent(event);
 }
 
-// callback from timer to show the next event
-static void do_next(ImageData *data)
+// show the next prepared event if we are ready for it
+static void showNextEvent(ImageData *data)
 {
-    if (data->trigger_flag == TRIGGER_CONTINUOUS) {
-        data->mNext = 1;
-        // generate a ClientMessage event to break us out of waiting in XtNextEvent()
-        if (data->mMainWindow && !XPending(data->display)) {
-            XClientMessageEvent xev;
-            memset(&xev, 0, sizeof(xev));
-            xev.type = ClientMessage;
-            xev.format = 8;
-            XSendEvent(data->display, XtWindow(data->mMainWindow->GetShell()), True, 0, (XEvent *)&xev);
+    PEventPreparer *prep = data->mPreparer;
+
+    // keep showing the current event until we are told to step to the next one
+    if (!prep || (data->mEvent && !data->mNext)) return;
+
+    AgedEvent *ev = prep->GetReady();
+    if (ev) {
+        data->mNext = 0;
+        // show the same prepared event in all main windows
+        for (PWindow *win=PWindow::sMainWindow; win; win=win->mNextMainWindow) {
+            ImageData *wdata = win->GetData();
+            displayEvent(wdata, ev);
+            // keep the event in our history so we can step back to it
+            if (wdata->mHistory) wdata->mHistory->Add(ev);
+            PEventControlWindow::UpdateHistoryLabel(wdata);
         }
     }
 }
 
-#if 1 //TEST
-void findWaveforms(TStoreEvent *anEvent, AgSignalsFlow* sigFlow)
+// handle the next X event
+// - returns zero if the main window was closed
+static int handleNextEvent(ImageData *data)
 {
-    const TObjArray *points = anEvent->GetSpacePoints();
-    int num = points->GetEntries();
-    for (int i=0; i<num; ++i) {
-        int found = 0;
-        TSpacePoint* spi = (TSpacePoint*)points->At(i);
-        for (auto it=sigFlow->AWwf.begin(); it!=sigFlow->AWwf.end(); ++it) {
-            if (i==0) printf("Wire i=%d s=%d\n",it->i,it->sec);
-            if (it->i == spi->GetWire()) {
-                found |= 0x01;
-                break;
-            }
-        }
-        for (auto it=sigFlow->PADwf.begin(); it!=sigFlow->PADwf.end(); ++it) {
-            int pad = TPCBase::TPCBaseInstance()->SectorAndPad2Index(it->sec, it->i);
-            if (pad  == spi->GetPad()) {
-                found |= 0x02;
-                break;
-            }
-        }
-        printf("Spacepoint %d wire=%d pad=%d\n", i,spi->GetWire(),spi->GetPad());
-        if (!(found & 0x01)) printf(" - no wire\n");
-        if (!(found & 0x02)) printf(" - no pad\n");
+    XEvent theEvent;
+    XtAppNextEvent(data->the_app, &theEvent);
+    // fast-forward to most recent pointer motion event (avoids
+    // falling behind current mouse position if drawing is slow)
+    if (theEvent.type == MotionNotify) {
+        while (XCheckTypedEvent(data->display, MotionNotify, &theEvent)) { }
     }
+    // dispatch the X event
+    dispatchEvent(&theEvent);
+    if (!data->mMainWindow) return(0);
+    // show the next event if one is ready and it is time
+    showNextEvent(data);
+    // update windows now if necessary (but only after all X events have been dispatched)
+    if (!XPending(data->display)) PWindow::HandleUpdates();
+    return(1);
 }
-#endif
 
-// Show ALPHA-g event in the display
-void Aged::ShowEvent(AgAnalysisFlow* anaFlow, AgSignalsFlow* sigFlow, TARunInfo* runinfo)
+// X event loop thread
+void *Aged::EventLoop(void *arg)
 {
-    ImageData *data = fData;
+    Aged *aged = (Aged *)arg;
+    ImageData *data = aged->fData;
 
-    if (data) clearEvent(data);
-
-    TStoreEvent *anEvent = anaFlow->fEvent;
-
-    if (!anEvent) return;
+    while (!aged->fQuit && data->mMainWindow && data->the_app) {
+        if (!handleNextEvent(data)) break;
+    }
+    // the display will take no more events
+    aged->fPreparer->Stop();
+    return(NULL);
+}
 
-#if 1 //TEST
-    findWaveforms(anEvent, sigFlow); //TEST
+// Show an event from any source (eg. PEventGenerator)
+// - called from the analysis thread
+// - copies the event and passes it to the preparation thread, then returns
+//   without waiting for it to be displayed (unless the submit policy is
+//   kSubmitBlock and the prefetch queue is full)
+// - the source need not remain valid after we return
+// - (the ROOT version of ShowEvent is in PRootEventSource.cxx)
+void Aged::ShowEvent(PEventSource *source, long run_number)
+{
+    // (only events accepted by the filter are recorded)
+    fPreparer->Submit(source, run_number, fRecorder);
+}
 
-    const TObjArray *points = anEvent->GetSpacePoints();
-    if (points) {
-        int num = points->GetEntries();
-        printf("...........................................\n");
-        for (int i=0; i<num; ++i) {
-            TSpacePoint* spi = (TSpacePoint*) points->At(i);
-            double x=spi->GetX(),y=spi->GetY(),z=spi->GetZ();
-            if (x*x+y*y>100) continue;
-            printf("BAD %d) %16lx %16lx %16lx %g %g %g time=%g h=%g r=%g phi=%g wire=%d pad=%d\n",
-                i, *(unsigned long *)&x, *(unsigned long *)&y, *(unsigned long *)&z,
-                x,y,z,
-                spi->GetTime(),spi->GetHeight(),spi->GetR(),spi->GetPhi(),spi->GetWire(),spi->GetPad());
-        }
+// Record all subsequent events that pass the event filter to a snapshot file
+// - closes any previous recording (pass a NULL filename to just stop recording)
+// - returns zero if the file could not be created
+int Aged::Record(const char *filename)
+{
+    if (fRecorder) {
+        Printf("%ld events recorded\n", fRecorder->GetNumEvents());
+        delete fRecorder;
+        fRecorder = NULL;
     }
-#endif
+    if (!filename) return(1);
+    fRecorder = new PSnapshotWriter(filename);
+    if (!fRecorder->IsOpen()) {
+        delete fRecorder;
+        fRecorder = NULL;
+        return(0);
+    }
+    return(1);
+}
+
+// Replay all events from a snapshot file
+// - called from the analysis thread (as for ShowEvent)
+// - returns the number of events submitted for display
+long Aged::Replay(const char *filename)
+{
+    PSnapshotReader reader(filename);
+    long num = 0;
 
-#if 0 //TEST
-    const TObjArray *helices = anEvent->GetHelixArray();
-    printf("%d HELICES -----------------\n",helices ? helices->GetEntries() : -1);
-    if (helices && helices->GetEntries() > 0) {
-        for (int i=0; i<helices->GetEntries(); ++i) {
-            TStoreHelix *helix = (TStoreHelix *)helices->At(i);
-            printf("Helix %d) c=%g phi=%g d=%g lam=%g xyz=(%g %g %g) p=(%g %g %g) beta=%g %d %d\n", i,
-                helix->GetC(), helix->GetPhi0(), helix->GetD(), helix->GetLambda(),
-                helix->GetX0(), helix->GetY0(), helix->GetZ0(),
-                helix->GetMomentumV().X(),helix->GetMomentumV().Y(),helix->GetMomentumV().Z(),
-                helix->GetFBeta(), helix->GetBranch(), helix->GetStatus());
+    for (long i=0; i<reader.GetNumEvents() && !fPreparer->IsStopped(); ++i) {
+        if (!reader.SetEvent(i)) {
+            Printf("Bad event %ld in snapshot file %s\n", i, filename);
+            continue;
         }
+        ShowEvent(&reader, reader.GetRunNumber());
+        ++num;
     }
-#endif
+    return(num);
+}
 
-    if (data) {
-        PEventControlWindow *pe_win = (PEventControlWindow *)data->mWindow[EVT_NUM_WINDOW];
-        if (pe_win) {
-            pe_win->Show();
-        } else {
-            data->mMainWindow->CreateWindow(EVT_NUM_WINDOW);
-        }
-        if (data->trigger_flag == TRIGGER_SINGLE) {
-            setTriggerFlag(data,TRIGGER_OFF);
-        }
+// Wait until all posted events have been displayed
+void Aged::Flush()
+{
+    fPreparer->WaitEmpty();
+}
 
-        // copy the space point XYZ positions into our Node array
-        const TObjArray *points = anEvent->GetSpacePoints();
-        if (points) {
-            int num = points->GetEntries();
-            Node *node = (Node *)XtMalloc(num*sizeof(Node));
-            if (!node) {
-                printf("Out of memory!\n");
-                return;
-            }
-            data->hits.hit_info  = (HitInfo *)XtMalloc(num*sizeof(HitInfo));
-            if (!data->hits.hit_info) {
-                printf("Out of memory!\n");
-                free(node);
-                return;
-            }
-            data->hits.nodes = node;
-            data->hits.num_nodes = num;
-            memset(data->hits.hit_info, 0, num*sizeof(HitInfo)); 
-            memset(node, 0, num*sizeof(Node));
-            HitInfo *hi = data->hits.hit_info;
-            for (int i=0; i<num; ++i, ++node, ++hi) {
-                TSpacePoint* spi = (TSpacePoint*)points->At(i);
-                node->x3 = spi->GetX() / AG_SCALE;
-                node->y3 = spi->GetY() / AG_SCALE;
-                node->z3 = spi->GetZ() / AG_SCALE;
-                hi->wire = spi->GetWire();
-                hi->pad = spi->GetPad();
-                hi->time = spi->GetTime();
-                hi->height = spi->GetHeight();
-                hi->error[0] = spi->GetErrX();
-                hi->error[1] = spi->GetErrY();
-                hi->error[2] = spi->GetErrZ();
-                hi->index = i;
-                if (isnan(hi->time)) hi->time = -1;
-                if (isnan(hi->height)) hi->height = -1;
-            }
-        }
-        
-        /* calculate the hit colour indices */
-        calcHitVals(data);
-    
-        data->agEvent = anEvent;
-        data->anaFlow = anaFlow;
-        data->sigFlow = sigFlow;
-        data->run_number = runinfo->fRunNo;
-        data->event_id = anEvent->GetEventNumber();
-    
-        sendMessage(data, kMessageNewEvent);
+void Aged::SetSubmitPolicy(int policy)
+{
+    fPreparer->SetPolicy(policy);
+}
 
-        if (data->trigger_flag == TRIGGER_CONTINUOUS) {
-            long delay = (long)(data->time_interval * 1000);
-            XtAppAddTimeOut(data->the_app, delay, (XtTimerCallbackProc)do_next, data);
-        }
-    }
-    // main event loop
-    while (data && data->mMainWindow!=NULL && !data->mNext) {
-        if (!data->the_app) return;
-        XEvent theEvent;
-        XtAppNextEvent(data->the_app, &theEvent);
-        // fast-forward to most recent pointer motion event (avoids
-        // falling behind current mouse position if drawing is slow)
-        if (theEvent.type == MotionNotify) {
-            while (XCheckTypedEvent(data->display, MotionNotify, &theEvent)) { }
-        }
-        // dispatch the X event
-        dispatchEvent(&theEvent);       
-        // update windows now if necessary (but only after all X events have been dispatched)
-        if (!XPending(data->display)) PWindow::HandleUpdates();
-    }
-    data->mNext = 0;
+// get counts of events submitted, displayed and dropped
+void Aged::GetCounts(long *submitted, long *displayed, long *dropped)
+{
+    *submitted = fPreparer->GetNumSubmitted();
+    *displayed = fPreparer->GetNumDisplayed();
+    *dropped   = fPreparer->GetNumDropped();
 }
 
@@ -8,21 +8,51 @@
 // Copyright (c) 2017, Phil Harvey, Queen's University
 //==============================================================================
 
+#include <atomic>
+#include <pthread.h>
+
 class AgAnalysisFlow;
 class AgSignalsFlow;
 class TARunInfo;
 class PWindow;
+class PEventPreparer;
+class PEventSource;
+class PSnapshotWriter;
+class PThreadPool;
 struct ImageData;
 
+/*
+** The X event loop runs in its own thread and events are prepared for
+** display by a worker thread, so ShowEvent() returns as soon as the event
+** has been copied from its source.  What happens when the display can't
+** keep up depends on the submit policy (ESubmitPolicy): wait for room (the
+** default), drop the new event, or replace the old one.
+*/
 class Aged
 {
 public:
     Aged();
     ~Aged();
     
-    void ShowEvent(AgAnalysisFlow* anaFlow, AgSignalsFlow* sigFlow, TARunInfo* runinfo);
+    void ShowEvent(AgAnalysisFlow* anaFlow, AgSignalsFlow* sigFlow, TARunInfo* runinfo); // (ROOT only)
+    void ShowEvent(PEventSource *source, long run_number);
+    void Flush();   // wait until all posted events have been displayed
+
+    int  Record(const char *filename);  // record events passing the filter (NULL to stop)
+    long Replay(const char *filename);  // show all events from a snapshot file
+
+    void SetSubmitPolicy(int policy);
+    void GetCounts(long *submitted, long *displayed, long *dropped);
 
 private:
-    ImageData   *fData;
-    PWindow     *fWindow;
+    static void *EventLoop(void *arg);
+
+    ImageData       *fData;
+    PWindow         *fWindow;
+    PEventPreparer  *fPreparer;     // prepares events and passes them to the X thread
+    PSnapshotWriter *fRecorder;     // snapshot file for recording events (or NULL)
+    PThreadPool     *fThreadPool;   // worker threads for loops over the hits
+    pthread_t       fThread;        // X event loop thread
+    int             fThreadOK;      // true if X thread was started
+    std::atomic<int> fQuit;         // flag for X thread to quit
 };
@@ -0,0 +1,78 @@
+//==============================================================================
+// File:        AgedEvent.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <string.h>
+#include "AgedEvent.h"
+#include "PEventPreparer.h"
+#include "PArena.h"
+
+// allocate a new empty event
+AgedEvent *newEvent(const char *arenaName)
+{
+    AgedEvent *ev = new AgedEvent;
+    memset(ev, 0, sizeof(AgedEvent));
+    ev->arena = new PArena(arenaName);
+    ev->vertex.x = -999;
+    return(ev);
+}
+
+// delete an event and all of its memory
+void deleteEvent(AgedEvent *ev)
+{
+    if (ev) {
+        delete ev->arena;
+        delete ev;
+    }
+}
+
+// reset an event to empty so it may be reused
+// - releases all event memory back to the arena
+void resetEvent(AgedEvent *ev)
+{
+    PArena          *arena = ev->arena;
+    PEventPreparer  *owner = ev->owner;
+
+    freeHits(&ev->hits);
+    arena->Reset();
+    memset(ev, 0, sizeof(AgedEvent));
+    ev->arena = arena;
+    ev->owner = owner;
+    ev->vertex.x = -999;
+}
+
+// add a reference to an event
+void retainEvent(AgedEvent *ev)
+{
+    ++ev->ref_count;
+}
+
+// release a reference to an event
+// - when the last reference is released, the event is recycled by
+//   its owner, or deleted if it has none
+void releaseEvent(AgedEvent *ev)
+{
+    if (--ev->ref_count > 0) return;
+    if (ev->owner) {
+        ev->owner->Recycle(ev);
+    } else {
+        deleteEvent(ev);
+    }
+}
+
+// get the waveform for the specified wire (NULL if none)
+AgedWaveform *getWireWaveform(AgedEvent *ev, int wire)
+{
+    if (!ev->wire_index || (unsigned)wire >= NUM_AG_WIRES) return((AgedWaveform *)NULL);
+    int index = ev->wire_index[wire];
+    return(index >= 0 ? ev->wire_wf + index : (AgedWaveform *)NULL);
+}
+
+// get the waveform for the specified pad index (NULL if none)
+AgedWaveform *getPadWaveform(AgedEvent *ev, int pad)
+{
+    if (!ev->pad_index || (unsigned)pad >= NUM_AG_PADS) return((AgedWaveform *)NULL);
+    int index = ev->pad_index[pad];
+    return(index >= 0 ? ev->pad_wf + index : (AgedWaveform *)NULL);
+}
@@ -0,0 +1,95 @@
+//==============================================================================
+// File:        AgedEvent.h
+//
+// Description: Event prepared for display
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __AgedEvent_h__
+#define __AgedEvent_h__
+
+#include "ImageData.h"
+#include "PEventSource.h"
+
+class PArena;
+class PEventPreparer;
+
+const int kMaxHelixNodes = 512;         // maximum number of nodes in a tessellated helix
+const int kWaveNone     = -1;           // waveform index for channel with no waveform
+const int kWaveWanted   = -2;           // waveform index for channel still being searched
+
+struct AgedLine {
+    Point3          end[2];             // line end points (units of AG_SCALE)
+    int             status;             // fit status
+};
+
+/*
+** A helix fit, tessellated finely enough for the highest magnification.
+** The nodes of all helices are packed into the helix_x3..z3 columns of the
+** event so that they may be projected together.
+*/
+struct AgedHelix {
+    int             first;              // index of first node in the helix node columns
+    int             num_nodes;          // number of tessellated nodes
+    Point3          origin;             // helix X0,Y0,Z0 (units of AG_SCALE)
+    int             status;             // fit status
+};
+
+struct AgedWaveform {
+    int             chan;               // wire number or pad index
+    int             num_samples;        // number of waveform samples
+    int           * samples;            // waveform samples
+};
+
+/*
+** An event converted into the form used by the display.
+** The raw data of an AgedEvent is copied from the source on the analysis
+** thread, then the event is finished by the PEventPreparer worker thread,
+** and neither touches it again until it is released by the X thread.  Once
+** prepared, an event is read-only and may be shared by all main windows and
+** their histories, each of which holds a reference (X thread only).
+** All memory hanging off the event comes from its arena.
+*/
+struct AgedEvent {
+    long            event_id;           // event number
+    long            run_number;         // run number
+    long            num_hits;           // number of hits reported by the analysis
+    long            num_tracks;         // number of tracks reported by the analysis
+
+    SpacePoints     hits;               // space points
+    HitScale        scale;              // colour scale used to calculate hit_val
+
+    int             num_lines;          // number of straight line fits
+    SourceLine    * src_lines;          // line fits as copied from the source
+    AgedLine      * lines;              // straight line fits
+    int             num_helices;        // number of helix fits
+    SourceHelix   * src_helices;        // helix fits as copied from the source
+    AgedHelix     * helices;            // helix fits
+    int             num_helix_nodes;    // total number of tessellated helix nodes
+    float         * helix_x3;           // helix nodes for all helices (units of AG_SCALE)
+    float         * helix_y3;
+    float         * helix_z3;
+    Point3          vertex;             // fit vertex in mm (x < -998 if none)
+
+    int             num_wire_wf;        // number of wire waveforms
+    AgedWaveform  * wire_wf;            // waveforms of the hit wires
+    int             num_pad_wf;         // number of pad waveforms
+    AgedWaveform  * pad_wf;             // waveforms of the hit pads
+    int           * wire_index;         // index in wire_wf for the hit wires (NUM_AG_WIRES)
+    int           * pad_index;          // index in pad_wf for the hit pads (NUM_AG_PADS)
+
+    int             ref_count;          // number of references held by the display
+    PArena        * arena;              // memory for this event
+    PEventPreparer* owner;              // preparer to recycle this event (or NULL)
+    AgedEvent     * next;               // next event in owner's free list
+};
+
+AgedEvent     * newEvent(const char *arenaName="Event");
+void            deleteEvent(AgedEvent *ev);
+void            resetEvent(AgedEvent *ev);
+void            retainEvent(AgedEvent *ev);
+void            releaseEvent(AgedEvent *ev);
+AgedWaveform  * getWireWaveform(AgedEvent *ev, int wire);
+AgedWaveform  * getPadWaveform(AgedEvent *ev, int pad);
+
+#endif // __AgedEvent_h__
@@ -5,6 +5,7 @@
 //==============================================================================
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include "AgedImage.h"
 #include "AgedWindow.h"
 #include "PResourceManager.h"
@@ -12,9 +13,12 @@
 #include "PSpeaker.h"
 #include "PUtils.h"
 #include "menu.h"
-#include "TStoreEvent.hh"
-#include "TStoreLine.hh"
-#include "TStoreHelix.hh"
+#include "AgedEvent.h"
+#include "camera.h"
+#include "project.h"
+#include "PThreadPool.h"
+#include "PArena.h"
+#include "CUtils.h"
 
 #define STRETCH             4
 
@@ -24,11 +28,12 @@
 #define NN_AXES             16
 #define NE_AXES             11
 
-const double kMaxR = 175 / AG_SCALE;   // maximum radius for helix track
-const double kMaxRSq = kMaxR * kMaxR;
-const double kFitLineLength = 1.5;
 const double kMinMagnification = 0.1;
 const double kMaxMagnification = 10;
+const int kHelixTolerance = 8;          // maximum screen length of a helix segment (pixels)
+const int kHelixSpan = 16;              // maximum nodes spanned by a helix segment
+const int kHelixCoarse = 4;             // helix tolerance factor for coarse drag frames
+const int kDragFastFrames = 8;          // fast drag frames before raising the fidelity
 
 static Point3 axes_nodes[NN_AXES] = {
                             {   0   ,  0   ,  0     },
@@ -60,10 +65,17 @@ AgedImage::AgedImage(PImageWindow *owner, Widget canvas)
     ImageData   *data = owner->GetData();
     
     mHitSize = 0;
+    mDragging = 0;
+    mDragLevel = kDragFull;
+    mDrawnLevel = kDragFull;
+    mFastFrames = 0;
+    mFrameStart = 0;
+    mLayersSaved = 0;
     mMinMagAtan = atan(kMinMagnification);
     mMaxMagAtan = atan(kMaxMagnification);
     mMarginPix = 2;
     mMarginFactor = 1.25;
+    mTrackCursor = 1;
     mProj = data->proj;
     mProj.proj_type = IDM_PROJ_3D;
     SetDirty(kDirtyAll);
@@ -120,15 +132,22 @@ void AgedImage::Listen(int message, void *dataPt)
             SetDirty(kDirtyCursor);
             break;
         case kMessageEventCleared:
-        case kMessageFitLinesChanged:
-        case kMessageHitSizeChanged:
-        case kMessageFitSizeChanged:
             SetDirty();
             break;
+        case kMessageColoursChanged:
+            // (background, detector and label colours may all have changed)
+            SetDirty();
+            break;
+        case kMessageHitsChanged:
+        case kMessageHitSizeChanged:
+            SetDirty(kDirtyHitLayer);
+            break;
         case kMessageNewEvent:
             SetDirty(kDirtyAll);
             break;
         case kMessageFitChanged:
+        case kMessageFitLinesChanged:
+        case kMessageFitSizeChanged:
             SetDirty(kDirtyFit);
             break;
         case kMessageAngleFormatChanged:
@@ -170,9 +189,7 @@ void AgedImage::CalcGrab2(int x,int y)
 void AgedImage::HandleEvents(XEvent *event)
 {
     float       xl,yl,zl;
-    Vector3     v1;
-    float       theta, phi, alpha;
-    Matrix3     tmp;
+    double      v1[3], len;
     ImageData   *data = mOwner->GetData();
     static int  rotate_flag;
     static int  update_flags;
@@ -184,6 +201,7 @@ void AgedImage::HandleEvents(XEvent *event)
         case kTimerEvent:
             SetCursor(CURSOR_MOVE_4);
             didDrag = 1;
+            mDragging = 1;
             break;
 
         case ButtonPress:
@@ -246,6 +264,11 @@ void AgedImage::HandleEvents(XEvent *event)
                 SetCursor(CURSOR_XHAIR);
                 XUngrabPointer(data->display, CurrentTime);
                 sButtonDown = 0;
+                mDragging = 0;
+                // redraw at full quality if the last frame was reduced
+                if (mDrawnLevel != kDragFull) {
+                    SetDirty(kDirtyAll);
+                }
 /*
 ** Update all necessary windows after grab is released
 */
@@ -275,6 +298,7 @@ void AgedImage::HandleEvents(XEvent *event)
                 if (dx>-4 && dx<4 && dy>-4 && dy<4) break;
                 SetCursor(CURSOR_MOVE_4);
                 didDrag = 1;
+                mDragging = 1;
                 ResetTimer();
             }
             xl = mGrabX;
@@ -300,17 +324,14 @@ void AgedImage::HandleEvents(XEvent *event)
             v1[1] = zl*mGrabX - xl*mGrabZ;
             v1[2] = xl*mGrabY - yl*mGrabX;
 
-            unitVector(v1);             /* (necessary for phi calculation) */
-
-            if (v1[0] || v1[1]) theta = atan2(v1[1],v1[0]);
-            else theta = 0;
-            phi   = acos(v1[2]);
-            alpha = -vectorLen(mGrabX-xl, mGrabY-yl, mGrabZ-zl);
-
-            getRotMatrix(tmp, theta, phi, alpha);
-
-            matrixMult(mProj.rot, tmp);
-            RotationChanged();
+            len = sqrt(v1[0]*v1[0] + v1[1]*v1[1] + v1[2]*v1[2]);
+            if (len) {
+                v1[0] /= len;
+                v1[1] /= len;
+                v1[2] /= len;
+                cameraRotate(&mProj, v1, vectorLen(mGrabX-xl, mGrabY-yl, mGrabZ-zl));
+                RotationChanged();
+            }
             SetDirty(kDirtyAll);
             break;
             
@@ -367,12 +388,9 @@ void AgedImage::ScrollValueChanged(EScrollBar bar, int value)
             Resize();
             break;
         case kScrollBottom: {
-            Matrix3 rot;
             float newSpin = (value - kScrollMax/2) * (4*PI) /kScrollMax;
-            get3DMatrix(rot,0.0,0.0,mSpinAngle-newSpin);
+            cameraSpin(&mProj, newSpin - mSpinAngle);
             mSpinAngle = newSpin;
-            matrixMult(rot,mProj.rot);
-            memcpy(mProj.rot,rot,sizeof(rot));
             RotationChanged();
             SetDirty(kDirtyAll);
         }   break;
@@ -399,49 +417,220 @@ void AgedImage::Resize()
 }
 
 
-void AgedImage::TransformHits()
+struct TransformArgs {
+    Projection    * pp;
+    SpacePoints   * hits;
+    ErrorBars     * bars;               // error bars to project (or NULL)
+};
+
+const int kErrBlock = 64 * ERR_NODES;   // error bar end points projected at a time
+
+// dot product of the rotated point with the vector from it to the projection
+// point (positive if the point is on the far side of the detector)
+// - xr,yr,zr are relative to the projection point, so the rotated point is
+//   (xr,yr,zr)+pt and the vector to the projection point is -(xr,yr,zr)
+static inline float hiddenDot(const float *pt, float xr, float yr, float zr)
 {
+    return(-(xr * (xr + pt[0]) + yr * (yr + pt[1]) + zr * (zr + pt[2])));
+}
+
+// transform a chunk of hits and find the ones on the far side of the detector
+static void transformHitChunk(void *arg, int begin, int end)
+{
+    Projection  *pp = ((TransformArgs *)arg)->pp;
+    SpacePoints *hits = ((TransformArgs *)arg)->hits;
+    float       *pt = pp->pt;
+    float       *xr = hits->xr;
+    float       *yr = hits->yr;
+    float       *zr = hits->zr;
+    int         *flags = hits->flags;
     int         i;
+
+    projectPoints(pp, end - begin, hits->x3 + begin, hits->y3 + begin, hits->z3 + begin,
+                  xr + begin, yr + begin, zr + begin, hits->x + begin, hits->y + begin,
+                  flags + begin);
+
+    if (pt[2] < pp->proj_max) {
+
+        for (i=begin; i<end; ++i) {
+            if (hiddenDot(pt, xr[i], yr[i], zr[i]) > 0) flags[i] |= NODE_HID;
+        }
+
+    } else {
+
+        for (i=begin; i<end; ++i) {
+            if (zr[i] > 0) flags[i] |= NODE_HID;
+        }
+    }
+
+    ErrorBars *bars = ((TransformArgs *)arg)->bars;
+    if (bars) {
+        // project the error bar end points for this chunk of hits
+        // (only the screen coordinates are kept)
+        float   exr[kErrBlock], eyr[kErrBlock], ezr[kErrBlock];
+        int     eflags[kErrBlock];
+        int     last = end * ERR_NODES;
+        memset(eflags, 0, sizeof(eflags));
+        for (i=begin*ERR_NODES; i<last; i+=kErrBlock) {
+            int n = last - i;
+            if (n > kErrBlock) n = kErrBlock;
+            projectPoints(pp, n, bars->x3 + i, bars->y3 + i, bars->z3 + i,
+                          exr, eyr, ezr, bars->x + i, bars->y + i, eflags);
+        }
+    }
+}
+
+void AgedImage::TransformHits()
+{
     ImageData   *data = mOwner->GetData();
-    int         num = data->hits.num_nodes;
+    SpacePoints *hits = &data->hits;
+    int         num = hits->num_nodes;
 #ifdef PRINT_DRAWS
     Printf(":transform 3-D\n");
 #endif
+    TransformArgs args = { &mProj, hits, NULL };
+    if (data->wSpStyle == IDM_SP_ERRORS && calcErrorBars(data)) {
+        args.bars = &data->err_bars;
+    }
     if (num) {
+        // (update the view here so the pool threads only read it)
+        cameraUpdateView(&mProj);
+        if (data->mThreadPool) {
+            data->mThreadPool->Run(num, transformHitChunk, &args);
+        } else {
+            transformHitChunk(&args, 0, num);
+        }
+    }
+    // (error bars are only projected in the error bar style)
+    data->err_bars.projected = (args.bars != NULL);
 
-        Node *node = data->hits.nodes;
-        
-        Transform(node,num);
-
-        float *pt = mProj.pt;
-        
-        if (pt[2] < mProj.proj_max) {
+    /* must do this to save mLastImage */
+    PProjImage::TransformHits();
+}
 
-            for (i=0; i<num; ++i,++node) {
-                float dot = (pt[0] - node->xr) * node->xr +
-                            (pt[1] - node->yr) * node->yr +
-                            (pt[2] - node->zr) * node->zr;
-                if (dot > 0) node->flags |= NODE_HID;
-            }
+// get the drawing colour for a helix fit
+static int helixColour(AgedHelix *helix)
+{
+    int col = FIT_BAD_COL + helix->status;
+    if (col < FIT_BAD_COL || col > FIT_PHOTON_COL) col = FIT_BAD_COL;
+    return(col);
+}
 
-        } else {
+/*
+** Add the segments joining helix nodes a to b, subdividing the range until
+** each segment is shorter than tol pixels on screen (or joins adjacent
+** tessellated nodes).  Returns the pointer to the next free segment.
+*/
+static XSegment *addHelixSegments(XSegment *sp, int *x, int *y, int *flags, int a, int b, int tol)
+{
+    if (b - a > 1) {
+        int dx = x[b] - x[a];
+        int dy = y[b] - y[a];
+        if (((flags[a] | flags[b]) & (NODE_HID | NODE_OUT)) ||
+            dx * dx + dy * dy > tol * tol)
+        {
+            int m = (a + b) / 2;
+            sp = addHelixSegments(sp, x, y, flags, a, m, tol);
+            return(addHelixSegments(sp, x, y, flags, m, b, tol));
+        }
+    } else if (flags[a] & flags[b] & (NODE_HID | NODE_OUT)) {
+        return(sp);
+    }
+    sp->x1 = x[a];
+    sp->y1 = y[a];
+    sp->x2 = x[b];
+    sp->y2 = y[b];
+    return(sp + 1);
+}
 
-            for (i=0; i<num; ++i,++node) {
-                if (node->zr > 0) node->flags |= NODE_HID;
+/*
+** Draw the helix fits, one request per colour
+** - the nodes of all helices are projected together, then each helix is drawn
+**   with only as many segments as needed at the current magnification
+*/
+void AgedImage::DrawHelices(AgedEvent *evt)
+{
+    PArena  *arena = mOwner->GetData()->mFrameArena;
+    int     num = evt->num_helix_nodes;
+    int     tol = kHelixTolerance;
+    int     i, j, col;
+
+    if (DragLevel() >= kDragCoarse) tol *= kHelixCoarse;
+
+    if (!num) return;
+
+    float    *xr = arena->New<float>(num);
+    float    *yr = arena->New<float>(num);
+    float    *zr = arena->New<float>(num);
+    int      *x = arena->New<int>(num);
+    int      *y = arena->New<int>(num);
+    int      *flags = arena->New<int>(num);
+    XSegment *segs = arena->New<XSegment>(num);
+    if (!xr || !yr || !zr || !x || !y || !flags || !segs) return;
+
+    memset(flags, 0, num * sizeof(int));
+    projectPoints(&mProj, num, evt->helix_x3, evt->helix_y3, evt->helix_z3,
+                  xr, yr, zr, x, y, flags);
+
+    for (col=FIT_BAD_COL; col<=FIT_PHOTON_COL; ++col) {
+        XSegment *sp = segs;
+        for (i=0; i<evt->num_helices; ++i) {
+            AgedHelix *helix = evt->helices + i;
+            if (helixColour(helix) != col) continue;
+            int last = helix->first + helix->num_nodes - 1;
+            // (start from short runs of nodes so no loops are missed)
+            for (j=helix->first; j<last; j+=kHelixSpan) {
+                int k = j + kHelixSpan;
+                if (k > last) k = last;
+                sp = addHelixSegments(sp, x, y, flags, j, k, tol);
             }
         }
+        if (sp == segs) continue;
+        SetForeground(col);
+        DrawSegments(segs, sp - segs);
     }
+}
 
-    /* must do this to save mLastImage */
-    PProjImage::TransformHits();
+/*
+** Draw the error bars of the hits that aren't masked, one request per colour
+** - the end points must already be projected by TransformHits()
+*/
+void AgedImage::DrawErrorBars(long mask)
+{
+    ImageData   *data = mOwner->GetData();
+    ErrorBars   *bars = &data->err_bars;
+    int         *order, *first;
+    int         ncols = SortHits(mask, &order, &first);
+
+    if (!ncols || !bars->projected) return;
+
+    XSegment *segs = data->mFrameArena->New<XSegment>(first[ncols] * 3);
+    if (!segs) return;
+
+    for (int c=0; c<ncols; ++c) {
+        int n = first[c+1] - first[c];
+        if (!n) continue;
+        int *ip = order + first[c];
+        XSegment *sp = segs;
+        for (int j=0; j<n; ++j) {
+            int *x = bars->x + ip[j] * ERR_NODES;
+            int *y = bars->y + ip[j] * ERR_NODES;
+            for (int k=0; k<ERR_NODES; k+=2, ++sp) {
+                sp->x1 = x[k];
+                sp->y1 = y[k];
+                sp->x2 = x[k+1];
+                sp->y2 = y[k+1];
+            }
+        }
+        SetForeground(FIRST_SCALE_COL + c);
+        DrawSegments(segs, sp - segs);
+    }
 }
 
 
 /* the rotation matrix has changed */
 void AgedImage::RotationChanged()
 {
-    matrixTranspose(mProj.rot,mProj.inv);
-    
     /* calculate current viewing angles */
     // theta is the angle from the z axis to the viewing direction
     if (mProj.rot[2][2]) {
@@ -495,6 +684,7 @@ void AgedImage::SetToHome(int n)
         mProj.rot[1][0] = 0;  mProj.rot[1][1] = 1;  mProj.rot[1][2] = 0;
         mProj.rot[2][0] = 0;  mProj.rot[2][1] = 0;  mProj.rot[2][2] = -1;
     }
+    cameraSetRotation(&mProj, mProj.rot);
     RotationChanged();
 
     Resize();
@@ -535,15 +725,10 @@ void AgedImage::CalcDetectorShading()
 void AgedImage::DrawSelf()
 {
     ImageData   *data = mOwner->GetData();
-    XSegment    segments[MAX_EDGES], *sp;
-    XPoint      point[6];
-    int         i,j,n,num;
-    Node        *n1,*n2;
-    Node        nod[6];
-    Edge        *edge, *last;
-    Face        *face, *lface;
+    int         dirty = IsDirty();
+    int         layer = kLayerDetector;     // first layer to draw
 
-    if (IsDirty() == kDirtyCursor) return; // don't draw if just our cursor changed
+    if (dirty == kDirtyCursor) return; // don't draw if just our cursor changed
 /*
 ** recalculate necessary values for display
 */
@@ -561,18 +746,58 @@ void AgedImage::DrawSelf()
         }
     }
 /*
-** Start drawing
+** Start drawing from the cached image below the first layer that changed
 */
+    if (dirty && !(dirty & ~(kDirtyHits | kDirtyHitLayer | kDirtyFit | kDirtyCursor))) {
+        layer = (dirty & (kDirtyHits | kDirtyHitLayer)) ? kLayerHits : kLayerFit;
+        if (!mLayersSaved || !mDrawable->RestoreLayer(layer - 1)) layer = kLayerDetector;
+    }
 #ifdef PRINT_DRAWS
-    Printf("draw 3-D image\n");
+    Printf("draw 3-D image from layer %d\n", layer);
 #endif
+    // time the frames while dragging
+    mDrawnLevel = DragLevel();
+    if (mDragging) mFrameStart = double_time();
+#ifdef ANTI_ALIAS
+    if (mDrawnLevel >= kDragNoSmooth) {
+        mDrawable->SetSmoothText(0);
+        mDrawable->SetSmoothLines(0);
+    }
+#endif
+    // (drag frames are always fully redrawn, so don't spend time saving
+    // the layers until the drag is over)
+    if (mDragging) mLayersSaved = 0;
+    if (layer <= kLayerDetector) {
+        DrawDetectorLayer();
+        if (!mDragging) mDrawable->SaveLayer(kLayerDetector);
+    }
+    if (layer <= kLayerHits) {
+        if (data->mEvent) DrawHitLayer();
+        if (!mDragging) mLayersSaved = mDrawable->SaveLayer(kLayerHits);
+    }
+    if (data->mEvent) DrawFitLayer();
+/*
+** Restore default drawing parameters
+*/
+    SetLineWidth(THICK_LINE_WIDTH);
+    SetForeground(TEXT_COL);
+}
+
+/*
+** Draw the background, angles, detector and axes
+*/
+void AgedImage::DrawDetectorLayer()
+{
+    ImageData   *data = mOwner->GetData();
+    XSegment    segments[MAX_EDGES], *sp;
+    XPoint      point[6];
+    int         i,j,n,num;
+    Node        *n1,*n2;
+    Edge        *edge, *last;
+    Face        *face, *lface;
 
     PImageCanvas::DrawSelf();   // let the base class clear the drawing area
 
-    // transform hits for this image if necessary
-    if (data->mLastImage != this) {
-        TransformHits();
-    }
     SetFont(data->hist_font);
 #ifdef ANTI_ALIAS
     SetFont(data->xft_hist_font);
@@ -597,8 +822,10 @@ void AgedImage::DrawSelf()
                 point[i].y = n1->y;
             }
             if (n<num) {
-                SetForeground(FIRST_DET_COL + (face->flags>>FACE_COL_SHFT));
-                FillPolygon(point,num);
+                if (DragLevel() < kDragCoarse) {
+                    SetForeground(FIRST_DET_COL + (face->flags>>FACE_COL_SHFT));
+                    FillPolygon(point,num);
+                }
 #if 1
                 // draw lines along back edges
                 for (i=0; i<num; ++i) {
@@ -655,84 +882,78 @@ void AgedImage::DrawSelf()
     DrawSegments(segments,sp-segments);
     SetLineWidth(THICK_LINE_WIDTH);
 
-    TStoreEvent *evt = data->agEvent;
-    if (!evt) return;
+}
+
+/*
+** Draw the space points
+*/
+void AgedImage::DrawHitLayer()
+{
+    ImageData   *data = mOwner->GetData();
+
+    // transform hits for this image if necessary
+    if (data->mLastImage != this) {
+        TransformHits();
+    }
+    SetLineWidth(THICK_LINE_WIDTH);
 /*
 ** Draw space points
 */
-    const TObjArray *points = evt->GetSpacePoints();
-    if (points && points->GetEntries() > 0 && data->wSpStyle != IDM_SP_NONE) {
-        num = points->GetEntries();
-        HitInfo *hi = data->hits.hit_info;
+    SpacePoints *hits = &data->hits;
+    if (hits->num_nodes && data->wSpStyle != IDM_SP_NONE) {
         int bit_mask = data->bit_mask;
         int sz = (int)(data->hit_size * 2 + 0.5);
-        double scl = data->hit_size / AG_SCALE;
-        for (i=0, n1=data->hits.nodes; i<num; ++i, ++hi, ++n1) {
-            if (hi->flags & bit_mask) continue; /* only consider unmasked hits */
-            SetForeground(FIRST_SCALE_COL + hi->hit_val);
-            switch (data->wSpStyle) {
-                case IDM_SP_ERRORS: {
-                    TSpacePoint* spi = (TSpacePoint*) points->At(i);
-                    nod[0].x3 = nod[1].x3 = nod[2].x3 = nod[3].x3 = nod[4].x3 = nod[5].x3 = n1->x3;
-                    nod[0].y3 = nod[1].y3 = nod[2].y3 = nod[3].y3 = nod[4].y3 = nod[5].y3 = n1->y3;
-                    nod[0].z3 = nod[1].z3 = nod[2].z3 = nod[3].z3 = nod[4].z3 = nod[5].z3 = n1->z3;
-                    nod[0].x3 -= spi->GetErrX() * scl;
-                    nod[1].x3 += spi->GetErrX() * scl;
-                    nod[2].y3 -= spi->GetErrY() * scl;
-                    nod[3].y3 += spi->GetErrY() * scl;
-                    nod[4].z3 -= spi->GetErrZ() * scl;
-                    nod[5].z3 += spi->GetErrZ() * scl;
-                    Transform(nod,6);
-                    for (j=0, sp=segments; j<6; j+=2, ++sp) {
-                        sp->x1 = nod[j].x;
-                        sp->y1 = nod[j].y;
-                        sp->x2 = nod[j+1].x;
-                        sp->y2 = nod[j+1].y;
-                    }
-                    DrawSegments(segments, 3);
-                }   break;
-                case IDM_SP_SQUARES:
-                    FillRectangle(n1->x-sz, n1->y-sz, sz*2+1, sz*2+1);
-                    break;
-                case IDM_SP_CIRCLES:
-                    FillArc(n1->x, n1->y, sz, sz);
+        switch (data->wSpStyle) {
+            case IDM_SP_SQUARES:
+                DrawHits(bit_mask, sz, 0);
+                break;
+            case IDM_SP_CIRCLES:
+                DrawHits(bit_mask, sz, 1);
+                break;
+            case IDM_SP_ERRORS:
+                if (DragLevel() >= kDragCoarse) {
+                    // (draw small squares instead while dragging)
+                    DrawHits(bit_mask, 1, 0);
                     break;
-            }
-        }
-    }
-#if 0 //TEST
-    if (points) {
-        for (int i=0; i<num; ++i) {
-            TSpacePoint* spi = (TSpacePoint*) points->At(i);
-            double x=spi->GetX(),y=spi->GetY(),z=spi->GetZ();
-            if (x*x+y*y>100) continue;
-            printf(">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n");
-            printf("%d) %g %g %g %lx %lx %lx time=%g h=%g r=%g phi=%g wire=%d pad=%d\n",
-                i,x,y,z,
-                *(unsigned long *)&x, *(unsigned long *)&y, *(unsigned long *)&z,
-                spi->GetTime(),spi->GetHeight(),spi->GetR(),spi->GetPhi(),spi->GetWire(),spi->GetPad());
+                }
+                if (!data->err_bars.projected || data->err_bars.hit_size != data->hit_size) {
+                    TransformHits();
+                }
+                DrawErrorBars(bit_mask);
+                break;
         }
     }
-#endif
+}
+
+/*
+** Draw the fit lines, helices and vertex
+*/
+void AgedImage::DrawFitLayer()
+{
+    ImageData   *data = mOwner->GetData();
+    AgedEvent   *evt = data->mEvent;
+    XSegment    segments[1], *sp;
+    int         i,j;
+    Node        nod[2];
+
+    SetLineWidth(THICK_LINE_WIDTH);
 /*
 ** Draw fit lines
 */
-    const TObjArray *lines = evt->GetLineArray();
-    if (data->show_fit && lines) {
-        for (i=0, sp=segments; i<lines->GetEntries(); ++i) {
-            TStoreLine *line = (TStoreLine *)lines->At(i);
-            nod[0].x3 = line->GetPoint()->X() / AG_SCALE;
-            nod[1].x3 = nod[0].x3 + line->GetDirection()->X() * kFitLineLength;
-            nod[0].y3 = line->GetPoint()->Y() / AG_SCALE;
-            nod[1].y3 = nod[0].y3 + line->GetDirection()->Y() * kFitLineLength;
-            nod[0].z3 = line->GetPoint()->Z() / AG_SCALE;
-            nod[1].z3 = nod[0].z3 + line->GetDirection()->Z() * kFitLineLength;
+    if (data->show_fit && evt->num_lines) {
+        for (i=0, sp=segments; i<evt->num_lines; ++i) {
+            AgedLine *line = evt->lines + i;
+            for (j=0; j<2; ++j) {
+                nod[j].x3 = line->end[j].x;
+                nod[j].y3 = line->end[j].y;
+                nod[j].z3 = line->end[j].z;
+            }
             Transform(nod, 2);
             sp->x1 = nod[0].x;
             sp->y1 = nod[0].y;
             sp->x2 = nod[1].x;
             sp->y2 = nod[1].y;
-            int col = FIT_BAD_COL + line->GetStatus();
+            int col = FIT_BAD_COL + line->status;
             if (col < FIT_BAD_COL || col > FIT_PHOTON_COL) col = FIT_BAD_COL;
             SetForeground(col);
             DrawSegments(segments, 1);
@@ -741,102 +962,69 @@ void AgedImage::DrawSelf()
 /*
 ** Draw fit helices
 */
-    const TObjArray *helices = evt->GetHelixArray();
-    if (data->show_fit && helices) {
-        for (i=0, sp=segments; i<helices->GetEntries(); ++i, ++sp) {
-            TStoreHelix *helix = (TStoreHelix *)helices->At(i);
-            const int kNumPoints = 100;
-            double r = 1 / (2 * helix->GetC());
-            double xc = -(r + helix->GetD()) * sin(helix->GetPhi0());
-            double yc =  (r + helix->GetD()) * cos(helix->GetPhi0());
-            double x0 = helix->GetX0();
-            double y0 = helix->GetY0();
-            double z0 = helix->GetZ0();
-            double scl = PI / kNumPoints;
-            double rla = r * helix->GetLambda();
-            // decide which direction to draw
-            if (helix->GetFBeta() * helix->GetMomentumV().Z() * rla > 0) {
-                scl *= -1;
-            }
-            n1 = n2 = 0;
-            int last = 0;
-            for (j=0, sp=segments; j<kNumPoints; ++j) {
-                // draw one half turn (or less) of the helix
-                double phi = helix->GetPhi0() + j * scl;
-                n1 = n2;
-                n2 = nod + (j & 1);
-                n2->x3 = (xc + r * sin(phi)) / AG_SCALE;
-                n2->y3 = (yc - r * cos(phi)) / AG_SCALE;
-                n2->z3 = (z0 + rla * j * scl) / AG_SCALE;
-                double r2sq = n2->x3*n2->x3 + n2->y3*n2->y3;
-                if (r2sq > kMaxRSq) {
-                    if (!j) break;
-                    // draw line to maximum
-                    double r1 = sqrt(n1->x3*n1->x3 + n1->y3*n1->y3);
-                    double f = (kMaxR - r1) / (sqrt(r2sq) - r1);
-                    n2->x3 = n1->x3 + f * (n2->x3 - n1->x3);
-                    n2->y3 = n1->y3 + f * (n2->y3 - n1->y3);
-                    n2->z3 = n1->z3 + f * (n2->z3 - n1->z3);
-                    last = 1;
-                }
-                Transform(n2,1);
-                if (!n1 || (n1->flags & n2->flags & (NODE_HID | NODE_OUT))) continue;
-                sp->x1 = n1->x;
-                sp->y1 = n1->y;
-                sp->x2 = n2->x;
-                sp->y2 = n2->y;
-                ++sp;
-                if (last) break;
-            }
-            int col = FIT_BAD_COL + helix->GetStatus();
-            if (col < FIT_BAD_COL || col > FIT_PHOTON_COL) col = FIT_BAD_COL;
-            SetForeground(col);
-            DrawSegments(segments, sp - segments);
+    if (data->show_fit && evt->num_helices) {
+        DrawHelices(evt);
 #if 1 //TEST
-            // draw X0,Y0,Z0
-            nod[0].x3 = x0 / AG_SCALE;
-            nod[0].y3 = y0 / AG_SCALE;
-            nod[0].z3 = z0 / AG_SCALE;
+        // draw X0,Y0,Z0
+        int sz = (int)(data->fit_size * 3 + 0.5);
+        for (i=0; i<evt->num_helices; ++i) {
+            AgedHelix *helix = evt->helices + i;
+            nod[0].x3 = helix->origin.x;
+            nod[0].y3 = helix->origin.y;
+            nod[0].z3 = helix->origin.z;
             Transform(nod,1);
-            int sz = (int)(data->fit_size * 3 + 0.5);
+            SetForeground(helixColour(helix));
             FillArc(nod[0].x, nod[0].y, sz, sz);
-#endif
         }
+#endif
     }
 /*
 ** Draw fit vertex
 */
-    if (data->show_fit && evt->GetVertex().X() > -998) {
-        nod[0].x3 = evt->GetVertex().X() / AG_SCALE;
-        nod[0].y3 = evt->GetVertex().Y() / AG_SCALE;
-        nod[0].z3 = evt->GetVertex().Z() / AG_SCALE;
+    if (data->show_fit && evt->vertex.x > -998) {
+        nod[0].x3 = evt->vertex.x / AG_SCALE;
+        nod[0].y3 = evt->vertex.y / AG_SCALE;
+        nod[0].z3 = evt->vertex.z / AG_SCALE;
         Transform(nod,1);
         int sz = (int)(data->fit_size * 3 + 0.5);
         SetForeground(VERTEX_COL);
         FillArc(nod[0].x, nod[0].y, sz, sz);
     }
-/*
-** Restore default drawing parameters
-*/
-    SetLineWidth(THICK_LINE_WIDTH);
-    SetForeground(TEXT_COL);
 }
 
 void AgedImage::AfterDrawing()
 {
     ImageData *data = mOwner->GetData();
 /*
+** Adjust the drag fidelity to keep the frame time within budget
+*/
+    if (mFrameStart) {
+        XSync(data->display, False);    // (include the time for the server to draw)
+        double ms = (double_time() - mFrameStart) * 1000;
+        mFrameStart = 0;
+        if (ms > data->drag_ms) {
+            if (mDragLevel < kDragCoarse) ++mDragLevel;
+            mFastFrames = 0;
+        } else if (ms < data->drag_ms / 4.0 && mDragLevel > kDragFull) {
+            // raise the fidelity after a run of fast frames
+            if (++mFastFrames >= kDragFastFrames) {
+                --mDragLevel;
+                mFastFrames = 0;
+            }
+        } else {
+            mFastFrames = 0;
+        }
+    }
+/*
 ** Draw the cursor
 */
     if (data->cursor_hit >= 0) {
-        Node *node, tmp;
-        node = data->hits.nodes + data->cursor_hit;
+        Node tmp, *node = &tmp;
+        getHitNode(&data->hits, data->cursor_hit, node);
         // remap only the node for this single hit if necessary
         if (data->mLastImage != this) {
-            memcpy(&tmp, node, sizeof(Node));
             tmp.flags &= ~(NODE_OUT | NODE_HID);
             Transform(&tmp, 1);
-            node = &tmp;
         }
         if (!(node->flags & NODE_OUT)) {
             SetLineWidth(2);
@@ -847,6 +1035,7 @@ void AgedImage::AfterDrawing()
             } else {
                 DrawArc(node->x, node->y, sz, sz);
             }
+            AddCursorRect(node->x-sz, node->y-sz, sz*2+1, sz*2+1);
             SetLineWidth(1);
         }
     }
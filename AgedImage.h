@@ -9,16 +9,38 @@
 #include "ImageData.h"
 #include "PProjImage.h"
 
+struct AgedEvent;
+
 enum AgedImageDirtyFlags {
-    kDirtyHits      = 0x02,
-    kDirtyFit       = 0x04,
+    kDirtyHits      = 0x02,     // hits must be transformed (and redrawn)
+    kDirtyFit       = 0x04,     // fit layer must be redrawn
     kDirtyDetector  = 0x08,
     kDirtyFrame     = 0x10,
     kDirtyAxes      = 0x20,
+    kDirtyHitLayer  = 0x40,     // hit layer must be redrawn
     
     kDirtyAll       = 0xfe
 };
 
+/*
+** Drawing fidelity while dragging, reduced to keep within the frame time budget
+*/
+enum EDragLevel {
+    kDragFull,                  // full quality
+    kDragNoSmooth,              // no anti-aliasing
+    kDragCoarse                 // also coarse helices, unfilled detector and no error bars
+};
+
+/*
+** Layers of the 3-D image, from the bottom up.  The image below each layer
+** is cached so that a change to one layer only redraws the layers above it.
+*/
+enum EAgedLayer {
+    kLayerDetector,             // background, angles, detector and axes
+    kLayerHits,                 // space points
+    kLayerFit                   // fit lines, helices and vertex (top layer, not cached)
+};
+
 class AgedImage : public PProjImage
 {
 public:
@@ -43,6 +65,12 @@ private:
     void            CalcGrab3(int x,int y);
     void            CalcDetectorShading();
     void            RotationChanged();
+    void            DrawDetectorLayer();
+    void            DrawHitLayer();
+    void            DrawFitLayer();
+    void            DrawErrorBars(long mask);
+    int             DragLevel()     { return mDragging ? mDragLevel : kDragFull; }
+    void            DrawHelices(AgedEvent *evt);
     
     Polyhedron          mDet;                   // detector geometry
     WireFrame           mAxes;                  // coordinate axes
@@ -51,6 +79,12 @@ private:
     double              mMaxMagAtan;            // arctan of maximum magnification
     float               mHitSize;               // last used size of PMT hexagon
     float               mGrabX,mGrabY,mGrabZ;   // 3-D mouse cursor coordinates for grab
+    int                 mDragging;              // set while dragging the image
+    int                 mDragLevel;             // fidelity for drag frames (EDragLevel)
+    int                 mDrawnLevel;            // fidelity of last frame drawn
+    int                 mFastFrames;            // number of consecutive fast drag frames
+    double              mFrameStart;            // start time of drag frame being drawn (or 0)
+    int                 mLayersSaved;           // true if the layer caches match the image
 };
 
 
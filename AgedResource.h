@@ -69,6 +69,15 @@ struct AgedResource {
     int             det_cols;                   // number of colours in detector colour scale
     Projection      proj;                       // current projection
     float           time_interval;              // time interval for displayed events
+    int             prefetch;                   // number of events to prepare ahead of display
+    int             submit_policy;              // policy for submitted events (ESubmitPolicy)
+    int             history_events;             // maximum number of events in history
+    int             history_mb;                 // maximum memory for event history (MB)
+    int             threads;                    // number of threads for hit loops (0 = one per core)
+    int             parallel_hits;              // minimum number of hits to use all threads
+    int             hit_lod;                    // flag to draw one hit per marker cell in dense events
+    int             drag_ms;                    // frame time budget while dragging the 3-D image (ms)
+    char          * raster_canvases;            // names of canvases to draw in client memory
     XFontStruct   * hist_font;                  // font for histograms
     XFontStruct   * label_font;                 // font for image labels
     XFontStruct   * label_big_font;             // big label font
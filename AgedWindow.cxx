@@ -32,6 +32,7 @@
 #include "PSettingsWindow.h"
 #include "PEventHistogram.h"
 #include "PMapImage.h"
+#include "PEventHistory.h"
 #include "PUtils.h"
 #include "aged_version.h"
 #include "menu.h"
@@ -46,6 +47,8 @@ static MenuStruct file_menu[] = {
     { "Next Event",         '>', XK_N,  IDM_NEXT_EVENT,     NULL, 0, 0},
     { "Clear Event",        'l', XK_l,  IDM_CLEAR_EVENT,    NULL, 0, 0},
     { NULL,                 0,   0,     0,                  NULL, 0, 0},
+    { "New Display",        0,   XK_D,  IDM_NEW_DISPLAY,    NULL, 0, 0},
+    { NULL,                 0,   0,     0,                  NULL, 0, 0},
     { "Next Space Point",   '+', XK_x,  IDM_NEXT_SPCPT,     NULL, 0, 0},
     { "Prev Space Point",   '-', XK_v,  IDM_PREV_SPCPT,     NULL, 0, 0},
     { NULL,                 0,   0,     0,                  NULL, 0, 0},
@@ -292,7 +295,7 @@ void AgedWindow::SetTitle(char *str)
         pt = strchr(buff, '[');                     /* find old run:event */
         if (pt > buff+1) --pt;  
         else pt = buff + strlen(buff);              /* pt points to end of title */
-        if (data->agEvent) {
+        if (data->mEvent) {
             sprintf(pt,data->hex_id ? " [Run %ld:0x%lx]" : " [Run %ld:%ld]",
                 data->run_number, data->event_id);
         } else *pt = 0;
@@ -403,10 +406,10 @@ void AgedWindow::UpdateSelf()
     ImageData *data = GetData();
     int n, num_disp = 0;
     if ((n = data->hits.num_nodes) != 0) {
-        HitInfo *hi = data->hits.hit_info;
+        short *flags = data->hits.hit_flags;
         long bit_mask = data->bit_mask;
-        for (int i=0; i<n; ++i,++hi) {
-            if (!(hi->flags & bit_mask)) ++num_disp;
+        for (int i=0; i<n; ++i) {
+            if (!(flags[i] & bit_mask)) ++num_disp;
         }
     }
     data->num_disp = num_disp;
@@ -933,9 +936,28 @@ int AgedWindow::CheckMenuCommand(int anID, int flags)
 
 void aged_next(ImageData *data, int direction)
 {
-    /* step forward in real time */
-    PEventControlWindow::SetEventFilter(data);
-    setTriggerFlag(data,TRIGGER_SINGLE);
+    PEventHistory *history = data->mHistory;
+    
+    if (history && (direction < 0 || history->GetNumBack())) {
+        /* step through the event history */
+        AgedEvent *ev = history->Step(direction);
+        if (ev) {
+            // stop live events so they don't replace the one we are looking at
+            if (data->trigger_flag != TRIGGER_OFF) {
+                setTriggerFlag(data,TRIGGER_OFF);
+            }
+            data->mNext = 0;
+            displayEvent(data, ev);
+            PEventControlWindow::UpdateHistoryLabel(data);
+        }
+    } else {
+        /* step forward in real time (live events are received by the base window) */
+        if (!data->mPreparer && PWindow::sMainWindow) {
+            data = PWindow::sMainWindow->GetData();
+        }
+        PEventControlWindow::SetEventFilter(data);
+        setTriggerFlag(data,TRIGGER_SINGLE);
+    }
 }
 
 //--------------------------------------------------------------------------------------
@@ -1015,8 +1037,22 @@ void AgedWindow::DoMenuCommand(int anID)
             clearEvent(data);
             break;
 
+        case IDM_NEW_DISPLAY: {
+            // open another main window showing the same event
+            AgedWindow *win = new AgedWindow(0);
+            win->GetData()->mThreadPool = sMainWindow->GetData()->mThreadPool;
+            AgedEvent *ev = sMainWindow->GetData()->mEvent;
+            if (ev) {
+                displayEvent(win->GetData(), ev);
+                if (win->GetData()->mHistory) win->GetData()->mHistory->Add(ev);
+            }
+        }   break;
+
         case IDM_QUIT:
-            if (PMenu::WasAccelerator()) {
+            if (this != sMainWindow) {
+                // close this display only
+                deleteData(data);
+            } else if (PMenu::WasAccelerator()) {
                 WarnQuit();
             } else {
                 deleteData(data);
@@ -15,9 +15,15 @@
 #include "PEventHistogram.h"
 #include "PEventControlWindow.h"
 #include "PResourceManager.h"
+#include "CUtils.h"
+#include "PArena.h"
+#include "AgedEvent.h"
+#include "PEventPreparer.h"
+#include "PEventHistory.h"
+#include "project.h"
+#include "PThreadPool.h"
 
 #define BUFFLEN             512
-#define PLOT_MAX            8000.0          /* maximum value for x,y plot coords */
 
 char *sFilePath = NULL;
 
@@ -29,6 +35,9 @@ void initData(ImageData *data, int load_settings)
     
     /* create speaker object */
     data->mSpeaker = new PSpeaker;
+    
+    /* create memory arena for drawing */
+    data->mFrameArena = new PArena("Frame");
 /*
 ** Initialize ImageData from resources
 */
@@ -84,6 +93,9 @@ void initData(ImageData *data, int load_settings)
     
     sFilePath = data->file_path;
     
+    /* create history of displayed events */
+    data->mHistory = new PEventHistory(data->history_events, data->history_mb);
+    
     for (i=0; i<2; ++i) {
         strncpy(data->print_string[i], data->print_string_pt[i], FILELEN);
         data->print_string[i][FILELEN-1] = '\0';
@@ -107,6 +119,15 @@ void freeData(ImageData *data)
     // clear the displayed event
     clearEvent(data);
     
+    // release the events in our history
+    delete data->mHistory;
+    data->mHistory = NULL;
+    
+    free(data->mHitView);
+    data->mHitView = NULL;
+    data->mHitViewSize = 0;
+    freeErrorBars(&data->err_bars);
+    
     XtFree(data->projName);
     data->projName = NULL;
     XtFree(data->dispName);
@@ -114,6 +135,15 @@ void freeData(ImageData *data)
     
     delete data->mSpeaker;
     data->mSpeaker = NULL;
+    
+    // (the event preparer and thread pool belong to the Aged object)
+    data->mPreparer = NULL;
+    data->mThreadPool = NULL;
+    
+    // report arena usage for tuning
+    data->mFrameArena->Report();
+    delete data->mFrameArena;
+    data->mFrameArena = NULL;
 }
 
 /* close all windows and delete image data */
@@ -137,15 +167,78 @@ void sendMessage(ImageData *data, int message, void *dataPt)
     data->mSpeaker->Speak(message, dataPt);
 }
 
+// generate a ClientMessage event to break the main loop out of waiting in XtAppNextEvent()
+void wakeEventLoop(ImageData *data)
+{
+    if (data->mMainWindow && !XPending(data->display)) {
+        XClientMessageEvent xev;
+        memset(&xev, 0, sizeof(xev));
+        xev.type = ClientMessage;
+        xev.format = 8;
+        XSendEvent(data->display, XtWindow(data->mMainWindow->GetShell()), True, 0, (XEvent *)&xev);
+        XFlush(data->display);
+    }
+}
+
+// callback from timer to show the next event
+static void do_next(ImageData *data)
+{
+    if (data->trigger_flag == TRIGGER_CONTINUOUS) {
+        data->mNext = 1;
+        wakeEventLoop(data);
+    }
+}
+
+// display a prepared event
+// - we hold a reference to the event until clearEvent()
+// - the event is read-only, so it may be displayed in more than one main window
+void displayEvent(ImageData *data, AgedEvent *ev)
+{
+    retainEvent(ev);    // (before clearing in case this is our current event)
+    clearEvent(data);
+
+    // (only the display receiving live events pops up the event control)
+    if (data->mPreparer) {
+        PEventControlWindow *pe_win = (PEventControlWindow *)data->mWindow[EVT_NUM_WINDOW];
+        if (pe_win) {
+            pe_win->Show();
+        } else {
+            data->mMainWindow->CreateWindow(EVT_NUM_WINDOW);
+        }
+    }
+    if (data->trigger_flag == TRIGGER_SINGLE) {
+        setTriggerFlag(data,TRIGGER_OFF);
+    }
+
+    data->mEvent = ev;
+    viewHits(data, &ev->hits);
+    data->run_number = ev->run_number;
+    data->event_id = ev->event_id;
+
+    /* recalculate the hit colours if the scale changed since the event was prepared */
+    HitScale scale;
+    getHitScale(data, &scale);
+    if (!sameHitScale(&scale, &ev->scale)) {
+        calcHitVals(data);
+    }
+    // use this scale for events prepared from now on
+    if (data->mPreparer) data->mPreparer->SetScale(&scale);
+
+    sendMessage(data, kMessageNewEvent);
+
+    if (data->trigger_flag == TRIGGER_CONTINUOUS) {
+        long delay = (long)(data->time_interval * 1000);
+        XtAppAddTimeOut(data->the_app, delay, (XtTimerCallbackProc)do_next, data);
+    }
+}
 
 void clearEvent(ImageData *data)
 {
-    if (data->hits.num_nodes) {
-        data->hits.num_nodes = 0;
-        free(data->hits.nodes);
-        data->hits.nodes = NULL;
-        free(data->hits.hit_info);
-        data->hits.hit_info = NULL;
+    freeHits(&data->hits);
+    // release our reference to the displayed event
+    if (data->mEvent) {
+        releaseEvent(data->mEvent);
+        data->mEvent = NULL;
     }
     data->cursor_hit = -1;
     data->run_number = 0;
@@ -153,7 +246,6 @@ void clearEvent(ImageData *data)
     data->cursor_sticky = 0;
     //setEventTime(data,0);
     data->display_time = 0;
-    data->agEvent = 0;
 
     if (data->mSpeaker) {
         sendMessage(data, kMessageEventCleared);
@@ -191,80 +283,319 @@ void setTriggerFlag(ImageData *data, int theFlag, int end_of_data)
 }
 
 // get hit value for currently displayed parameter
-float getHitVal(ImageData *data, HitInfo *hi)
+float getHitVal(ImageData *data, int num)
+{
+    return(getHitValType(&data->hits, data->wDataType, num));
+}
+
+// getHitValPad - get hit value, padding with +0.5 for integer data types
+float getHitValPad(ImageData *data, int num)
+{
+    float   val = getHitVal(data, num);
+    
+    if (isIntegerDataType(data)) {
+        val += 0.5;
+    }
+    return(val);
+}
+
+// get hit value for the specified data type (IDM_ menu ID)
+float getHitValType(SpacePoints *hits, int data_type, int num)
 {
-    float val;
+    float val = 0;
     
-    switch (data->wDataType) {
+    switch (data_type) {
         case IDM_TIME:
-            val = hi->time;
+            val = hits->time[num];
             break;
         case IDM_HEIGHT:
-            val = hi->height;
+            val = hits->height[num];
             break;
         case IDM_ERROR:
-            val = sqrt(hi->error[0]*hi->error[0] + hi->error[1]*hi->error[1] + hi->error[2]*hi->error[2]);
+            val = sqrt(hits->error[0][num] * hits->error[0][num] +
+                       hits->error[1][num] * hits->error[1][num] +
+                       hits->error[2][num] * hits->error[2][num]);
             break;
         case IDM_DISP_WIRE:
-            val = hi->wire;
+            val = hits->wire[num];
             break;
         case IDM_DISP_PAD:
-            val = hi->pad;
+            val = hits->pad[num];
             break;
     }
     return(val);
 }
 
-// getHitValPad - get hit value, padding with +0.5 for integer data types
-float getHitValPad(ImageData *data, HitInfo *hi)
+// get the current hit colour scale settings
+// - must be called from the UI thread since it looks at the event histogram
+void getHitScale(ImageData *data, HitScale *scale)
 {
-    float   val = getHitVal(data, hi);
-    
-    if (isIntegerDataType(data)) {
-        val += 0.5;
-    }
-    return(val);
+    scale->data_type = data->wDataType;
+    scale->ncols = data->num_cols - 2;
+    PEventHistogram::GetBins(data, &scale->first, &scale->last);
 }
 
-// calculate the colours corresponding to hit values for display
-void calcHitVals(ImageData *data)
+// return non-zero if two hit scales will produce the same hit colours
+int sameHitScale(HitScale *s1, HitScale *s2)
+{
+    return(s1->data_type == s2->data_type &&
+           s1->ncols     == s2->ncols &&
+           s1->first     == s2->first &&
+           s1->last      == s2->last);
+}
+
+// calculate the colours corresponding to hit values for the specified scale
+// - does not access ImageData, so this may be called from any thread
+// - calculates colours for hits begin to end-1 (end < 0 for all hits)
+void calcHitColours(SpacePoints *hits, HitScale *scale, int begin, int end)
 {
     int     i;
-    float   val, first, last, range;
+    float   val, pad, first, range;
     long    ncols;
-    HitInfo *hi;
+    short   *flags, *hit_val;
     int     n;
 
-    hi = data->hits.hit_info;
-    n  = data->hits.num_nodes;
+    flags   = hits->hit_flags;
+    hit_val = hits->hit_val;
+    n       = end < 0 ? hits->num_nodes : end;
     
-    PEventHistogram::GetBins(data, &first, &last);
-    range = last - first;
+    first = scale->first;
+    range = scale->last - first;
+    ncols = scale->ncols;
+    pad   = isIntegerType(scale->data_type) ? 0.5 : 0;
 /*
 ** Calculate colour indices for each hit
 */
-    ncols = data->num_cols - 2;
-    for (i=0; i<n; ++i,++hi) {
-        if (hi->flags & HIT_DISCARDED) {
-            hi->hit_val = (int)ncols + 2;
+    for (i=begin; i<n; ++i) {
+        if (flags[i] & HIT_DISCARDED) {
+            hit_val[i] = (int)ncols + 2;
             continue;
         }
         // calculate scaled hit value
-        val = ncols * (getHitValPad(data, hi) - first) / range;
+        val = ncols * (getHitValType(hits, scale->data_type, i) + pad - first) / range;
 
         // reset over/underscale flags
-        hi->flags &= ~(HIT_OVERSCALE|HIT_UNDERSCALE);
+        flags[i] &= ~(HIT_OVERSCALE|HIT_UNDERSCALE);
         if (val < 0) {
             val = -1;
-            hi->flags |= HIT_UNDERSCALE;    // set underscale flag
+            flags[i] |= HIT_UNDERSCALE;     // set underscale flag
         } else if (val >= ncols) {
             val = ncols;
-            hi->flags |= HIT_OVERSCALE;     // set overscale flag
+            flags[i] |= HIT_OVERSCALE;      // set overscale flag
         }
-        hi->hit_val = (int)val + 1;
+        hit_val[i] = (int)val + 1;
     }
 }
 
+struct HitColourArgs {
+    SpacePoints   * hits;
+    HitScale      * scale;
+};
+
+static void calcHitColourChunk(void *arg, int begin, int end)
+{
+    calcHitColours(((HitColourArgs *)arg)->hits, ((HitColourArgs *)arg)->scale, begin, end);
+}
+
+// calculate the colours corresponding to hit values for display
+void calcHitVals(ImageData *data)
+{
+    HitScale    scale;
+    
+    getHitScale(data, &scale);
+    if (data->mThreadPool) {
+        HitColourArgs args = { &data->hits, &scale };
+        data->mThreadPool->Run(data->hits.num_nodes, calcHitColourChunk, &args);
+    } else {
+        calcHitColours(&data->hits, &scale);
+    }
+}
+
+/*
+** Allocate the columns of the hit store for the specified number of hits
+** - memory is taken from the arena if specified, otherwise from the heap
+** - all columns are cleared to zero
+** - the xr..flags view columns are not allocated if view is zero
+** - returns zero if out of memory
+*/
+int allocHits(SpacePoints *hits, int num, PArena *arena, int view)
+{
+    freeHits(hits);
+    
+    // pad column length so vectorized loops may run past the last hit
+    int     max = (num + HIT_COL_PAD - 1) / HIT_COL_PAD * HIT_COL_PAD;
+    size_t  len4 = max * 4;         // length of a 4-byte column
+    size_t  len2 = (max * 2 + HIT_COL_ALIGN - 1) / HIT_COL_ALIGN * HIT_COL_ALIGN;
+    size_t  size = (view ? 16 : 10) * len4 + 2 * len2;
+    void    *mem;
+    
+    if (!max) return(1);
+    
+    if (arena) {
+        mem = arena->Alloc(size + HIT_COL_ALIGN);
+        if (!mem) return(0);
+        // (arena memory is only kArenaAlign aligned)
+        mem = (void *)(((size_t)mem + HIT_COL_ALIGN - 1) & ~(size_t)(HIT_COL_ALIGN - 1));
+    } else if (posix_memalign(&mem, HIT_COL_ALIGN, size)) {
+        Printf("Out of memory for %d hits\n", num);
+        return(0);
+    }
+    memset(mem, 0, size);
+    
+    char *pt = (char *)mem;
+    hits->mem       = pt;
+    hits->arena     = arena;
+    hits->x3        = (float *)pt;  pt += len4;
+    hits->y3        = (float *)pt;  pt += len4;
+    hits->z3        = (float *)pt;  pt += len4;
+    if (view) {
+        hits->xr    = (float *)pt;  pt += len4;
+        hits->yr    = (float *)pt;  pt += len4;
+        hits->zr    = (float *)pt;  pt += len4;
+        hits->x     = (int *)pt;    pt += len4;
+        hits->y     = (int *)pt;    pt += len4;
+        hits->flags = (int *)pt;    pt += len4;
+    }
+    hits->time      = (float *)pt;  pt += len4;
+    hits->height    = (float *)pt;  pt += len4;
+    hits->error[0]  = (float *)pt;  pt += len4;
+    hits->error[1]  = (float *)pt;  pt += len4;
+    hits->error[2]  = (float *)pt;  pt += len4;
+    hits->wire      = (int *)pt;    pt += len4;
+    hits->pad       = (int *)pt;    pt += len4;
+    hits->hit_val   = (short *)pt;  pt += len2;
+    hits->hit_flags = (short *)pt;
+    hits->max_nodes = max;
+    hits->num_nodes = num;
+    return(1);
+}
+
+/*
+** Set our hits to view the shared columns of a prepared event
+** - the view columns are allocated in memory owned by this ImageData
+**   (reused from event to event), and the hit colours and flags are
+**   copied from the event
+** - returns zero if out of memory
+*/
+int viewHits(ImageData *data, SpacePoints *shared)
+{
+    SpacePoints *hits = &data->hits;
+    
+    *hits = *shared;
+    data->err_bars.hit_size = -1;   // (error bars are for the old hits)
+    
+    int     max = shared->max_nodes;
+    size_t  len4 = max * 4;
+    size_t  len2 = (max * 2 + HIT_COL_ALIGN - 1) / HIT_COL_ALIGN * HIT_COL_ALIGN;
+    size_t  size = 6 * len4 + 2 * len2;
+    
+    if (!max) return(1);
+    
+    if (size > data->mHitViewSize) {
+        free(data->mHitView);
+        data->mHitViewSize = 0;
+        if (posix_memalign((void **)&data->mHitView, HIT_COL_ALIGN, size)) {
+            Printf("Out of memory for %d hits\n", shared->num_nodes);
+            data->mHitView = NULL;
+            memset(hits, 0, sizeof(SpacePoints));
+            return(0);
+        }
+        data->mHitViewSize = size;
+    }
+    char *pt = data->mHitView;
+    memset(pt, 0, 6 * len4);
+    hits->xr        = (float *)pt;  pt += len4;
+    hits->yr        = (float *)pt;  pt += len4;
+    hits->zr        = (float *)pt;  pt += len4;
+    hits->x         = (int *)pt;    pt += len4;
+    hits->y         = (int *)pt;    pt += len4;
+    hits->flags     = (int *)pt;    pt += len4;
+    hits->hit_val   = (short *)pt;  pt += len2;
+    hits->hit_flags = (short *)pt;
+    memcpy(hits->hit_val, shared->hit_val, max * sizeof(short));
+    memcpy(hits->hit_flags, shared->hit_flags, max * sizeof(short));
+    return(1);
+}
+
+void freeHits(SpacePoints *hits)
+{
+    if (hits->mem && !hits->arena) free(hits->mem);
+    memset(hits, 0, sizeof(SpacePoints));
+}
+
+/*
+** Generate the error bar end points for the displayed hits if necessary
+** - the end points are kept until the event or the hit size changes
+** - returns zero if out of memory
+*/
+int calcErrorBars(ImageData *data)
+{
+    ErrorBars   *bars = &data->err_bars;
+    SpacePoints *hits = &data->hits;
+    int         num = hits->num_nodes * ERR_NODES;
+
+    if (bars->hit_size == data->hit_size && bars->num_nodes == num) return(1);
+
+    if (num > bars->max_nodes) {
+        int     max = (num + HIT_COL_PAD - 1) / HIT_COL_PAD * HIT_COL_PAD;
+        void    *mem;
+        freeErrorBars(bars);
+        if (posix_memalign(&mem, HIT_COL_ALIGN, 5 * max * 4)) {
+            Printf("Out of memory for %d error bars\n", hits->num_nodes);
+            return(0);
+        }
+        char *pt = bars->mem = (char *)mem;
+        bars->x3 = (float *)pt;     pt += max * 4;
+        bars->y3 = (float *)pt;     pt += max * 4;
+        bars->z3 = (float *)pt;     pt += max * 4;
+        bars->x  = (int *)pt;       pt += max * 4;
+        bars->y  = (int *)pt;
+        bars->max_nodes = max;
+    }
+    double scl = data->hit_size / AG_SCALE;
+    float *x3 = bars->x3;
+    float *y3 = bars->y3;
+    float *z3 = bars->z3;
+    for (int i=0, n=0; i<hits->num_nodes; ++i, n+=ERR_NODES) {
+        for (int j=0; j<ERR_NODES; ++j) {
+            x3[n+j] = hits->x3[i];
+            y3[n+j] = hits->y3[i];
+            z3[n+j] = hits->z3[i];
+        }
+        x3[n+0] -= hits->error[0][i] * scl;
+        x3[n+1] += hits->error[0][i] * scl;
+        y3[n+2] -= hits->error[1][i] * scl;
+        y3[n+3] += hits->error[1][i] * scl;
+        z3[n+4] -= hits->error[2][i] * scl;
+        z3[n+5] += hits->error[2][i] * scl;
+    }
+    bars->num_nodes = num;
+    bars->hit_size = data->hit_size;
+    bars->projected = 0;
+    return(1);
+}
+
+void freeErrorBars(ErrorBars *bars)
+{
+    free(bars->mem);
+    memset(bars, 0, sizeof(ErrorBars));
+    bars->hit_size = -1;
+}
+
+// copy the geometry of a single hit into a Node
+void getHitNode(SpacePoints *hits, int num, Node *node)
+{
+    node->x3    = hits->x3[num];
+    node->y3    = hits->y3[num];
+    node->z3    = hits->z3[num];
+    node->xr    = hits->xr[num];
+    node->yr    = hits->yr[num];
+    node->zr    = hits->zr[num];
+    node->x     = hits->x[num];
+    node->y     = hits->y[num];
+    node->flags = hits->flags[num];
+}
+
 void initNodes(WireFrame *fm, Point3 *pt, int num)
 {
     int     i;
@@ -524,74 +855,45 @@ char *loadGeometry(Polyhedron *poly, int geo, char *argv)
  */
 void transform(Node *node, Projection *pp, int num)
 {
-    int     i;
-    float   f;
-    float   x,y,z;
-    float   xt,yt,zt;
-    float   axt,ayt;
-    float   xsc   = pp->xscl;
-    float   ysc   = pp->yscl;
-    int     xcn   = pp->xcen;
-    int     ycn   = pp->ycen;
-    float   (*rot)[3] = pp->rot;
-    float  *vec  = pp->pt;
-    int     pers  = vec[2] < pp->proj_max;
-
-    for (i=0; i<num; ++i,++node) {
-        x = node->x3;
-        y = node->y3;
-        z = node->z3;
-        xt = (node->xr = x*rot[0][0] + y*rot[0][1] + z*rot[0][2]) - vec[0];
-        yt = (node->yr = x*rot[1][0] + y*rot[1][1] + z*rot[1][2]) - vec[1];
-        zt = (node->zr = x*rot[2][0] + y*rot[2][1] + z*rot[2][2]) - vec[2];
-
-        // reset NODE_OUT and NODE_HID flags
-        node->flags &= ~(NODE_OUT | NODE_HID);
-        
-        if (pers) {
-            if (zt >= 0) {
-                node->flags |= NODE_OUT;
-                axt = fabs(xt);
-                ayt = fabs(yt);
-                if (axt > ayt) f = PLOT_MAX/axt;
-                else  if (ayt) f = PLOT_MAX/ayt;
-                else {
-                    f = PLOT_MAX;
-                    xt = yt = 1;
-                }
-                node->x =   (int)(f * xt);
-                node->y = - (int)(f * yt);
-            } else {
-/*
-** Distort image according to projection point while maintaining
-** a constant magnification for the projection screen.
-*/
-                x = xcn + xt * (pp->proj_screen-vec[2]) * xsc / zt;
-                y = ycn - yt * (pp->proj_screen-vec[2]) * ysc / zt;
-                axt = fabs(x);
-                ayt = fabs(y);
-                if (axt>PLOT_MAX || ayt>PLOT_MAX) {
-                    node->flags |= NODE_OUT;
-                    if (axt > ayt) f = PLOT_MAX/axt;
-                    else  if (ayt) f = PLOT_MAX/ayt;
-                    else {
-                        f = PLOT_MAX;
-                        x = y = 1;
-                    }
-                    node->x = (int)(f * x);
-                    node->y = (int)(f * y);
-                } else {
-                    node->x = (int)(x);
-                    node->y = (int)(y);
-                }
-            }
-        } else {
-            node->x = (int)(xcn + xsc * xt);
-            node->y = (int)(ycn - ysc * yt);
+    const int kBlock = 64;
+    float   x3[kBlock], y3[kBlock], z3[kBlock];
+    float   xr[kBlock], yr[kBlock], zr[kBlock];
+    int     x[kBlock], y[kBlock], flags[kBlock];
+
+    // gather the nodes into columns for the projection kernel
+    while (num > 0) {
+        int n = num < kBlock ? num : kBlock;
+        for (int i=0; i<n; ++i) {
+            x3[i] = node[i].x3;
+            y3[i] = node[i].y3;
+            z3[i] = node[i].z3;
+            flags[i] = node[i].flags;
         }
+        projectPoints(pp, n, x3, y3, z3, xr, yr, zr, x, y, flags);
+        for (int i=0; i<n; ++i) {
+            node[i].xr = xr[i];
+            node[i].yr = yr[i];
+            node[i].zr = zr[i];
+            node[i].x = x[i];
+            node[i].y = y[i];
+            node[i].flags = flags[i];
+        }
+        node += n;
+        num -= n;
     }
 }
 
+/*
+ * columnar version of transform() for the hit store
+ * Inputs: hits->x3,y3,z3
+ * Outputs: hits->x,y,xr,yr,zr,flags
+ */
+void transformHits(SpacePoints *hits, Projection *pp)
+{
+    projectPoints(pp, hits->num_nodes, hits->x3, hits->y3, hits->z3,
+                  hits->xr, hits->yr, hits->zr, hits->x, hits->y, hits->flags);
+}
+
 void transformPoly(Polyhedron *poly, Projection *pp)
 {
     int     i;
@@ -643,7 +945,12 @@ void transformPoly(Polyhedron *poly, Projection *pp)
 
 int isIntegerDataType(ImageData *data)
 {
-    switch (data->wDataType) {
+    return(isIntegerType(data->wDataType));
+}
+
+int isIntegerType(int data_type)
+{
+    switch (data_type) {
         case IDM_TIME:
         case IDM_HEIGHT:
         case IDM_ERROR:
@@ -53,7 +53,7 @@ struct Point3 {
 
 struct Node {
     float       x3,y3,z3;           // physical sphere coordinates (radius=1)
-    float       xr,yr,zr;           // rotated physical coordinates
+    float       xr,yr,zr;           // rotated coordinates relative to projection point
     int         x,y;                // screen coordinates after rotating
     int         flags;              // flag for x,y outside limits
 };
@@ -88,26 +88,72 @@ struct Polyhedron {
     float       radius;
 };
 
-struct HitInfo {
-    float       height;             // pulse height
-    float       time;               // pulse time
-    float       error[3];           // error in XYZ position
-    short       hit_val;            // colour index for drawing this hit
-    short       index;              // index of hi in position array
-    int         wire;               // wire number
-    int         pad;                // pad number
-    short       flags;              // hit info flags
+class PArena;
+
+#define HIT_COL_ALIGN   64              // byte alignment of each hit store column
+#define HIT_COL_PAD     16              // column lengths are padded to a multiple of this
+
+/*
+** Columnar (structure-of-arrays) store for the space points of an event.
+** Every attribute lives in its own contiguous, aligned column so that a pass
+** over one attribute (transform, colour calculation, nearest-hit search...)
+** only touches the memory it needs.  All columns share a single allocation,
+** and the columns are padded to HIT_COL_PAD entries beyond num_nodes.
+**
+** The view columns (xr..flags, hit_val and hit_flags) depend on the display.
+** Each main window gets its own copy of these from viewHits(), and shares
+** the remaining columns with the other windows showing the same event.
+*/
+struct SpacePoints {
+    int         num_nodes;          // number of space points
+    int         max_nodes;          // allocated (padded) length of each column
+    char      * mem;                // memory block holding all columns
+    PArena    * arena;              // arena owning the memory block (NULL if malloc'd)
+    
+    float     * x3, * y3, * z3;     // physical coordinates (units of AG_SCALE)
+    float     * xr, * yr, * zr;     // rotated coordinates relative to projection point
+    int       * x,  * y;            // screen coordinates after projecting
+    int       * flags;              // node flags (NODE_HID, NODE_OUT)
+    
+    float     * time;               // pulse time
+    float     * height;             // pulse height
+    float     * error[3];           // error in XYZ position
+    int       * wire;               // wire number
+    int       * pad;                // pad number
+    short     * hit_val;            // colour index for drawing this hit
+    short     * hit_flags;          // hit info flags (HitInfoFlags)
 };
 
-struct SpacePoints {
-    int         num_nodes;
-    Node        *nodes;
-    HitInfo     *hit_info;          // corresponding array of hit information
+#define ERR_NODES       6               // error bar end points per hit (-x,+x,-y,+y,-z,+z)
+
+/*
+** End points of the error bars of the displayed hits.  These are generated
+** once for each event and hit size, and projected along with the hits.
+*/
+struct ErrorBars {
+    int         num_nodes;          // number of end points (ERR_NODES per hit)
+    int         max_nodes;          // allocated length of each column
+    float       hit_size;           // hit size for the end points (<0 if not valid)
+    int         projected;          // non-zero if x,y are up to date
+    char      * mem;                // memory block holding all columns
+    float     * x3, * y3, * z3;     // end points (units of AG_SCALE)
+    int       * x,  * y;            // screen coordinates after projecting
+};
+
+/*
+** Snapshot of the settings used to map hit values to colour indices.
+** (taken on the UI thread so that hit colours may be calculated elsewhere)
+*/
+struct HitScale {
+    int         data_type;          // displayed data type (IDM_ menu ID)
+    float       first, last;        // hit values at the ends of the colour scale
+    long        ncols;              // number of colours in the scale
 };
 
-class TStoreEvent;
-class AgAnalysisFlow;
-class AgSignalsFlow;
+struct AgedEvent;
+class PEventPreparer;
+class PEventHistory;
+class PThreadPool;
 
 struct ImageData : AgedResource {
     AgedWindow    * mMainWindow;        // main Aged window
@@ -117,14 +163,19 @@ struct ImageData : AgedResource {
     PProjImage    * mLastImage;         // last projection image to transform hits
     PProjImage    * mCursorImage;       // last image to be cursor'd in
     PHistImage    * mScaleHist;         // histogram image currently being scaled
+    PArena        * mFrameArena;        // scratch memory for drawing (reset before each draw)
+    PEventPreparer* mPreparer;          // source of prepared events (owned by Aged object)
+    PEventHistory * mHistory;           // recently displayed events
+    PThreadPool   * mThreadPool;        // worker threads for loops over hits (owned by Aged object)
     int             mNext;              // true to step to next event (exit event loop)
 
-    TStoreEvent   * agEvent;            // the event we are displaying
-    AgAnalysisFlow* anaFlow;            // the analysis flow
-    AgSignalsFlow * sigFlow;            // the signals flow
+    AgedEvent     * mEvent;             // the prepared event we are displaying (shared)
+    char          * mHitView;           // memory for view columns of our hits
+    size_t          mHitViewSize;       // allocated size of mHitView
 
     Widget          toplevel;           // top level Aged widget
-    SpacePoints     hits;               // tube hit information
+    SpacePoints     hits;               // hit information (view columns owned by us, others by mEvent)
+    ErrorBars       err_bars;           // error bars for the displayed hits
     
     Node            sun_dir;            // direction to sun
     int             num_disp;           // number of displayed hits
@@ -149,6 +200,8 @@ struct ImageData : AgedResource {
     double          display_time;       // time to display next event
 
     int             trigger_flag;       // trigger flag (continuous/single/off)
+    char            filter_expr[FORMAT_LEN];// event filter expression
+    unsigned        trigger_mask;       // trigger bits to accept (0 = any)
     long            run_number;         // run number for event
     int             last_cur_x;         // last cursor x location
     int             last_cur_y;         // last cursor y location
@@ -162,6 +215,13 @@ void    initEdges(WireFrame *fm, int *n1, int *n2, int num);
 char *  loadGeometry(Polyhedron *poly, int geo, char *argv);
 void    transform(Node *node, Projection *pp, int num);
 void    transformPoly(Polyhedron *poly, Projection *pp);
+void    transformHits(SpacePoints *hits, Projection *pp);
+int     allocHits(SpacePoints *hits, int num, PArena *arena=NULL, int view=1);
+int     viewHits(ImageData *data, SpacePoints *shared);
+void    freeHits(SpacePoints *hits);
+int     calcErrorBars(ImageData *data);
+void    freeErrorBars(ErrorBars *bars);
+void    getHitNode(SpacePoints *hits, int num, Node *node);
 struct tm *getTms(double aTime, int time_zone);
 int isIntegerDataType(ImageData *data);
 
@@ -170,10 +230,18 @@ void    freeData(ImageData *data);
 void    deleteData(ImageData *data);
 void    sendMessage(ImageData *data, int message, void *dataPt=NULL);
 void    aged_next(ImageData *data, int dir);
+void    wakeEventLoop(ImageData *data);
 void    setTriggerFlag(ImageData *data, int theFlag, int end_of_data=0);
 void    setLabel(ImageData *data, int on);
-float   getHitValPad(ImageData *data, HitInfo *hi);
+float   getHitVal(ImageData *data, int num);
+float   getHitValPad(ImageData *data, int num);
+float   getHitValType(SpacePoints *hits, int data_type, int num);
+int     isIntegerType(int data_type);
+void    getHitScale(ImageData *data, HitScale *scale);
+int     sameHitScale(HitScale *s1, HitScale *s2);
+void    calcHitColours(SpacePoints *hits, HitScale *scale, int begin=0, int end=-1);
 void    calcHitVals(ImageData *data);
+void    displayEvent(ImageData *data, AgedEvent *ev);
 void    clearEvent(ImageData *data);
 
 #endif // __ImageData_h__
@@ -0,0 +1,99 @@
+//==============================================================================
+// File:        PArena.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <stdlib.h>
+#include "PArena.h"
+#include "CUtils.h"
+
+const size_t kMinBlockSize = 64 * 1024;    // minimum size of an arena block
+
+PArena::PArena(const char *name, size_t initialSize)
+{
+    mName           = name;
+    mBlock          = NULL;
+    mSize           = 0;
+    mUsed           = 0;
+    mHighWater      = 0;
+    mNumHeapAllocs  = 0;
+    
+    if (initialSize) NewBlock(initialSize);
+}
+
+PArena::~PArena()
+{
+    FreeBlocks();
+}
+
+// allocate a new block and make it the current block
+PArena::Block * PArena::NewBlock(size_t size)
+{
+    if (size < kMinBlockSize) size = kMinBlockSize;
+    
+    Block *block = (Block *)malloc(kHeaderSize + size);
+    if (!block) {
+        Printf("Out of memory for %s arena\n", mName);
+        return(NULL);
+    }
+    ++mNumHeapAllocs;
+    block->next = mBlock;
+    block->size = size;
+    block->used = 0;
+    mBlock = block;
+    mSize += size;
+    return(block);
+}
+
+void PArena::FreeBlocks()
+{
+    while (mBlock) {
+        Block *next = mBlock->next;
+        free(mBlock);
+        mBlock = next;
+    }
+    mSize = 0;
+}
+
+// Alloc - allocate memory from the arena
+// - align must be a power of 2 no greater than kArenaAlign
+// - returns NULL if out of memory
+void * PArena::Alloc(size_t size, size_t align)
+{
+    Block *block = mBlock;
+    size_t pos = 0;
+    
+    if (block) {
+        pos = (block->used + align - 1) & ~(align - 1);
+    }
+    if (!block || pos + size > block->size) {
+        // grow by at least the current arena size
+        block = NewBlock(size > mSize ? size : mSize);
+        if (!block) return(NULL);
+        pos = 0;
+    }
+    // track the size of a single block that would hold everything since the reset
+    mUsed = ((mUsed + align - 1) & ~(align - 1)) + size;
+    if (mHighWater < mUsed) mHighWater = mUsed;
+    block->used = pos + size;
+    return((char *)block + kHeaderSize + pos);
+}
+
+// Reset - release all memory allocated from the arena
+void PArena::Reset()
+{
+    if (mBlock && mBlock->next) {
+        // coalesce into a single block that will hold the high-water mark
+        FreeBlocks();
+        NewBlock(mHighWater);
+    } else if (mBlock) {
+        mBlock->used = 0;
+    }
+    mUsed = 0;
+}
+
+void PArena::Report()
+{
+    Printf("%s arena: high-water %ld kB, size %ld kB, %ld heap allocations\n", mName,
+           (long)(mHighWater + 1023) / 1024, (long)(mSize + 1023) / 1024, mNumHeapAllocs);
+}
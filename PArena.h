@@ -0,0 +1,57 @@
+//==============================================================================
+// File:        PArena.h
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PArena_h__
+#define __PArena_h__
+
+#include <stddef.h>
+
+const size_t kArenaAlign = 16;      // default alignment of arena allocations
+
+/*
+** PArena - bump allocator for memory with a well-defined lifetime
+**
+** Memory is handed out sequentially from large blocks and is released all
+** at once by Reset().  When the arena has had to grow since the last reset,
+** Reset() replaces the blocks with a single block large enough for the
+** high-water mark, so a steady-state workload makes no further heap calls.
+*/
+class PArena {
+public:
+    PArena(const char *name, size_t initialSize=0);
+    ~PArena();
+    
+    void          * Alloc(size_t size, size_t align=kArenaAlign);
+    template <class T>
+    T             * New(size_t num)     { return (T *)Alloc(num * sizeof(T)); }
+    void            Reset();
+    
+    size_t          GetUsed()           { return mUsed; }
+    size_t          GetHighWater()      { return mHighWater; }
+    size_t          GetSize()           { return mSize; }
+    long            GetNumHeapAllocs()  { return mNumHeapAllocs; }
+    void            Report();
+    
+private:
+    struct Block {
+        Block     * next;               // next (older) block in chain
+        size_t      size;               // usable size of this block
+        size_t      used;               // number of bytes used in this block
+    };
+    // size of block header, rounded up to keep the data aligned
+    static const size_t kHeaderSize = (sizeof(Block) + kArenaAlign - 1) & ~(kArenaAlign - 1);
+    
+    Block         * NewBlock(size_t size);
+    void            FreeBlocks();
+    
+    const char    * mName;              // arena name (for reporting)
+    Block         * mBlock;             // current block (head of chain)
+    size_t          mSize;              // total usable size of all blocks
+    size_t          mUsed;              // bytes allocated since last reset
+    size_t          mHighWater;         // maximum bytes allocated between resets
+    long            mNumHeapAllocs;     // number of heap allocations made
+};
+
+#endif // __PArena_h__
@@ -0,0 +1,1046 @@
+//==============================================================================
+// File:        PDrawRaster.cxx
+//
+// Description: Drawing routines for a client-side raster image
+//
+// Notes:       Lines, arcs and polygons are scan converted here, and glyphs
+//              are cached per font (core font glyphs are fetched from the
+//              server once, and Xft glyphs are rendered by FreeType).
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef MIT_SHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "PDrawRaster.h"
+#include "PDrawXPixmap.h"
+#include "PUtils.h"
+
+#ifndef PI
+#define PI              3.14159265358979324
+#endif
+
+const int kMinArcPoints = 8;
+const int kMaxArcPoints = 120;
+const int kMaxPolyPoints = 64;      // polygon points handled without allocating memory
+const int kAASub = 4;               // anti-aliasing sub-scanlines per pixel row
+const int kDashLen = 4;             // length of dashes and gaps for dashed lines
+
+struct RasterGlyph {
+    int             left;               // bitmap offset right of the origin
+    int             top;                // bitmap offset above the baseline
+    int             width;              // bitmap width
+    int             height;             // bitmap height
+    int             advance;            // distance to the next glyph origin
+    unsigned char * cover;              // glyph coverage (0-255) for each bitmap pixel
+};
+
+struct RasterFont {
+    void          * id;                 // XFontStruct or XftFont for this cache
+    int             smooth;             // non-zero if this is an Xft font
+    RasterGlyph   * glyph[256];         // glyphs loaded so far
+    RasterFont    * next;               // next font in list
+};
+
+//---------------------------------------------------------------------------------------
+// Pixel utilities
+//
+
+// fill a span of pixels with a constant value
+static void fillSpan(uint32_t *p, int n, uint32_t pixel)
+{
+#ifdef __SSE2__
+    __m128i v = _mm_set1_epi32((int)pixel);
+    for (; n >= 16; n -= 16, p += 16) {
+        _mm_storeu_si128((__m128i *)p, v);
+        _mm_storeu_si128((__m128i *)(p + 4), v);
+        _mm_storeu_si128((__m128i *)(p + 8), v);
+        _mm_storeu_si128((__m128i *)(p + 12), v);
+    }
+    for (; n >= 4; n -= 4, p += 4) {
+        _mm_storeu_si128((__m128i *)p, v);
+    }
+#endif
+    while (n-- > 0) *p++ = pixel;
+}
+
+// blend a pixel value into a destination pixel with alpha a (0-256)
+static inline uint32_t blendPixel(uint32_t dst, uint32_t src, int a, const uint32_t *mask)
+{
+    uint32_t out = dst & ~(mask[0] | mask[1] | mask[2]);
+    for (int k=0; k<3; ++k) {
+        uint64_t m = mask[k];
+        out |= (uint32_t)((((src & m) * (uint64_t)a + (dst & m) * (uint64_t)(256 - a)) >> 8) & m);
+    }
+    return(out);
+}
+
+// blend a constant pixel value into a span of pixels
+static void blendSpan(uint32_t *p, int n, uint32_t pixel, int a, const uint32_t *mask)
+{
+#ifdef __SSE2__
+    // vector version for the usual 8 bits per colour channel
+    if (mask[0] == 0xff0000 && mask[1] == 0xff00 && mask[2] == 0xff) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32((int)pixel), zero);
+        __m128i va = _mm_set1_epi16((short)a);
+        __m128i vb = _mm_set1_epi16((short)(256 - a));
+        __m128i sa = _mm_mullo_epi16(src, va);
+        __m128i keep = _mm_set1_epi32((int)0xff000000);
+        for (; n >= 4; n -= 4, p += 4) {
+            __m128i d = _mm_loadu_si128((__m128i *)p);
+            __m128i lo = _mm_unpacklo_epi8(d, zero);
+            __m128i hi = _mm_unpackhi_epi8(d, zero);
+            lo = _mm_srli_epi16(_mm_add_epi16(sa, _mm_mullo_epi16(lo, vb)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(sa, _mm_mullo_epi16(hi, vb)), 8);
+            __m128i r = _mm_packus_epi16(lo, hi);
+            // (leave the unused top byte of each pixel alone)
+            r = _mm_or_si128(_mm_andnot_si128(keep, r), _mm_and_si128(keep, d));
+            _mm_storeu_si128((__m128i *)p, r);
+        }
+    }
+#endif
+    for (; n > 0; --n, ++p) {
+        *p = blendPixel(*p, pixel, a, mask);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Glyph loading
+//
+
+// get a core font glyph by drawing it into a bitmap on the server
+// - this is done only once for each character of each font
+static RasterGlyph *loadCoreGlyph(Display *dpy, XFontStruct *font, int c)
+{
+    RasterGlyph *glyph = new RasterGlyph;
+    memset(glyph, 0, sizeof(RasterGlyph));
+
+    if ((unsigned)c < font->min_char_or_byte2 || (unsigned)c > font->max_char_or_byte2) {
+        return(glyph);
+    }
+    XCharStruct *cs = font->per_char ? font->per_char + (c - font->min_char_or_byte2)
+                                     : &font->max_bounds;
+    glyph->left = cs->lbearing;
+    glyph->top = cs->ascent;
+    glyph->width = cs->rbearing - cs->lbearing;
+    glyph->height = cs->ascent + cs->descent;
+    glyph->advance = cs->width;
+    if (glyph->width <= 0 || glyph->height <= 0) {
+        glyph->width = glyph->height = 0;
+        return(glyph);
+    }
+    Pixmap pix = XCreatePixmap(dpy, DefaultRootWindow(dpy), glyph->width, glyph->height, 1);
+    XGCValues values;
+    values.foreground = 0;
+    values.font = font->fid;
+    GC gc = XCreateGC(dpy, pix, GCForeground | GCFont, &values);
+    XFillRectangle(dpy, pix, gc, 0, 0, glyph->width, glyph->height);
+    XSetForeground(dpy, gc, 1);
+    char ch = (char)c;
+    XDrawString(dpy, pix, gc, -cs->lbearing, cs->ascent, &ch, 1);
+    XImage *image = XGetImage(dpy, pix, 0, 0, glyph->width, glyph->height, 1, XYPixmap);
+    if (image) {
+        glyph->cover = new unsigned char[glyph->width * glyph->height];
+        unsigned char *cp = glyph->cover;
+        for (int y=0; y<glyph->height; ++y) {
+            for (int x=0; x<glyph->width; ++x) {
+                *(cp++) = XGetPixel(image, x, y) ? 255 : 0;
+            }
+        }
+        XDestroyImage(image);
+    }
+    XFreeGC(dpy, gc);
+    XFreePixmap(dpy, pix);
+    return(glyph);
+}
+
+#ifdef ANTI_ALIAS
+// get an anti-aliased glyph rendered by FreeType
+static RasterGlyph *loadXftGlyph(XftFont *font, int c)
+{
+    RasterGlyph *glyph = new RasterGlyph;
+    memset(glyph, 0, sizeof(RasterGlyph));
+
+    FT_Face face = XftLockFace(font);
+    if (!face) return(glyph);
+    if (!FT_Load_Char(face, c, FT_LOAD_RENDER)) {
+        FT_GlyphSlot slot = face->glyph;
+        FT_Bitmap *bm = &slot->bitmap;
+        glyph->left = slot->bitmap_left;
+        glyph->top = slot->bitmap_top;
+        glyph->width = bm->width;
+        glyph->height = bm->rows;
+        glyph->advance = (int)((slot->advance.x + 32) >> 6);
+        if (glyph->width > 0 && glyph->height > 0) {
+            glyph->cover = new unsigned char[glyph->width * glyph->height];
+            unsigned char *cp = glyph->cover;
+            for (int y=0; y<glyph->height; ++y) {
+                unsigned char *row = bm->buffer + y * bm->pitch;
+                for (int x=0; x<glyph->width; ++x) {
+                    if (bm->pixel_mode == FT_PIXEL_MODE_MONO) {
+                        *(cp++) = (row[x >> 3] & (0x80 >> (x & 7))) ? 255 : 0;
+                    } else {
+                        *(cp++) = row[x];
+                    }
+                }
+            }
+        } else {
+            glyph->width = glyph->height = 0;
+        }
+    }
+    XftUnlockFace(font);
+    return(glyph);
+}
+#endif
+
+//---------------------------------------------------------------------------------------
+// PDrawRaster constructor
+//
+PDrawRaster::PDrawRaster(Display *dpy, GC gc, int depth, Widget w)
+{
+    mDpy = dpy;
+    mGC = gc;
+    mDepth = depth;
+    mWidget = w;
+    mDirect = new PDrawXPixmap(dpy, gc, depth, w);
+    mRaster = 0;
+    mImage = NULL;
+    mBuff = NULL;
+    memset(mLayer, 0, sizeof(mLayer));
+    mCover = NULL;
+    mCoverMin = 0;
+    mCoverMax = -1;
+    mWidth = 0;
+    mHeight = 0;
+    mPixel = 0;
+    mAlpha = 256;
+    mLineWidth = 1;
+    mDash = 0;
+    mFonts = NULL;
+    memset(mSprite, 0, sizeof(mSprite));
+#ifdef MIT_SHM
+    mShm = 0;
+    mShmPending = 0;
+    mUseShm = ShmWorks(dpy);
+#endif
+
+    Visual *visual = DefaultVisual(dpy, DefaultScreen(dpy));
+    mMask[0] = (uint32_t)visual->red_mask;
+    mMask[1] = (uint32_t)visual->green_mask;
+    mMask[2] = (uint32_t)visual->blue_mask;
+}
+
+PDrawRaster::~PDrawRaster()
+{
+    FreeImage();
+    while (mFonts) {
+        RasterFont *next = mFonts->next;
+        for (int i=0; i<256; ++i) {
+            if (mFonts->glyph[i]) {
+                delete [] mFonts->glyph[i]->cover;
+                delete mFonts->glyph[i];
+            }
+        }
+        delete mFonts;
+        mFonts = next;
+    }
+    for (int i=0; i<2; ++i) {
+        for (int j=0; j<=kMaxMarkerRadius; ++j) {
+            delete [] mSprite[i][j];
+        }
+    }
+    delete mDirect;
+}
+
+// check that the display can take our 32-bit images
+int PDrawRaster::IsSupported(Display *dpy, int depth)
+{
+    Visual *visual = DefaultVisual(dpy, DefaultScreen(dpy));
+#if defined(__cplusplus) || defined(c_plusplus)
+    if (visual->c_class != TrueColor) return(0);
+#else
+    if (visual->class != TrueColor) return(0);
+#endif
+    if (depth != 24 && depth != 32) return(0);
+
+    int n, ok = 0;
+    XPixmapFormatValues *formats = XListPixmapFormats(dpy, &n);
+    if (formats) {
+        for (int i=0; i<n; ++i) {
+            if (formats[i].depth == depth && formats[i].bits_per_pixel == 32) {
+                ok = 1;
+                break;
+            }
+        }
+        XFree(formats);
+    }
+    return(ok);
+}
+
+#ifdef MIT_SHM
+static int sShmError = 0;
+
+static int shmErrorHandler(Display *dpy, XErrorEvent *event)
+{
+    sShmError = 1;
+    return(0);
+}
+
+// attach a shared memory segment to the server (returns zero on error)
+// - the server can't attach our memory if it is on another host
+static int shmAttach(Display *dpy, XShmSegmentInfo *info)
+{
+    XSync(dpy, False);
+    sShmError = 0;
+    XErrorHandler oldHandler = XSetErrorHandler(shmErrorHandler);
+    XShmAttach(dpy, info);
+    XSync(dpy, False);
+    XSetErrorHandler(oldHandler);
+    return(!sShmError);
+}
+
+// check that the server can use shared memory images from this client
+int PDrawRaster::ShmWorks(Display *dpy)
+{
+    XShmSegmentInfo info;
+
+    if (!XShmQueryExtension(dpy)) return(0);
+    info.shmid = shmget(IPC_PRIVATE, 1, IPC_CREAT | 0600);
+    if (info.shmid < 0) return(0);
+    info.shmaddr = (char *)shmat(info.shmid, NULL, 0);
+    shmctl(info.shmid, IPC_RMID, NULL);     // (removed when all have detached)
+    if (info.shmaddr == (char *)-1) return(0);
+    info.readOnly = True;
+    int ok = shmAttach(dpy, &info);
+    if (ok) {
+        XShmDetach(dpy, &info);
+        XSync(dpy, False);
+    }
+    shmdt(info.shmaddr);
+    return(ok);
+}
+
+// create mImage in a shared memory segment (returns zero on error)
+int PDrawRaster::CreateShmImage(int width, int height)
+{
+    mImage = XShmCreateImage(mDpy, DefaultVisual(mDpy, DefaultScreen(mDpy)), mDepth,
+                             ZPixmap, NULL, &mShmInfo, width, height);
+    if (!mImage) return(0);
+    // our pixels must be 32-bit words in the native byte order
+    uint32_t one = 1;
+    if (mImage->bits_per_pixel != 32 ||
+        mImage->bytes_per_line != width * (int)sizeof(uint32_t) ||
+        mImage->byte_order != (*(unsigned char *)&one ? LSBFirst : MSBFirst))
+    {
+        XDestroyImage(mImage);
+        mImage = NULL;
+        return(0);
+    }
+    mShmInfo.shmid = shmget(IPC_PRIVATE, mImage->bytes_per_line * height, IPC_CREAT | 0600);
+    if (mShmInfo.shmid >= 0) {
+        mShmInfo.shmaddr = (char *)shmat(mShmInfo.shmid, NULL, 0);
+        shmctl(mShmInfo.shmid, IPC_RMID, NULL);
+        if (mShmInfo.shmaddr != (char *)-1) {
+            mShmInfo.readOnly = True;
+            if (shmAttach(mDpy, &mShmInfo)) {
+                mImage->data = mShmInfo.shmaddr;
+                mBuff = (uint32_t *)mShmInfo.shmaddr;
+                mShm = 1;
+                return(1);
+            }
+            shmdt(mShmInfo.shmaddr);
+        }
+    }
+    XDestroyImage(mImage);
+    mImage = NULL;
+    return(0);
+}
+#endif
+
+void PDrawRaster::FreeImage()
+{
+    for (int i=0; i<kMaxDrawLayers; ++i) {
+        free(mLayer[i]);
+        mLayer[i] = NULL;
+    }
+    if (mImage) {
+        mImage->data = NULL;    // (we free our own buffer)
+        XDestroyImage(mImage);
+        mImage = NULL;
+    }
+#ifdef MIT_SHM
+    if (mShm) {
+        XShmDetach(mDpy, &mShmInfo);
+        shmdt(mShmInfo.shmaddr);
+        mShm = 0;
+        mShmPending = 0;
+        mBuff = NULL;
+    }
+#endif
+    free(mBuff);
+    mBuff = NULL;
+    delete [] mCover;
+    mCover = NULL;
+    mWidth = 0;
+    mHeight = 0;
+}
+
+//---------------------------------------------------------------------------------------
+// BeginDrawing
+//
+int PDrawRaster::BeginDrawing(int width, int height)
+{
+    if (mWidth != width || mHeight != height) {
+        FreeImage();
+    }
+    if (!mBuff) {
+        if (width <= 0 || height <= 0) return(0);
+#ifdef MIT_SHM
+        if (mUseShm && !CreateShmImage(width, height)) {
+            mUseShm = 0;    // (use ordinary images from now on)
+        }
+        if (!mShm) {
+#endif
+        mBuff = (uint32_t *)malloc(width * height * sizeof(uint32_t));
+        if (mBuff) {
+            mImage = XCreateImage(mDpy, DefaultVisual(mDpy, DefaultScreen(mDpy)), mDepth,
+                                  ZPixmap, 0, (char *)mBuff, width, height, 32,
+                                  width * sizeof(uint32_t));
+        }
+        if (!mImage) {
+            Printf("No memory for raster image!\x07\n");
+            FreeImage();
+            return(0);
+        }
+        // our pixels are stored in the native byte order
+        uint32_t one = 1;
+        mImage->byte_order = *(unsigned char *)&one ? LSBFirst : MSBFirst;
+#ifdef MIT_SHM
+        }
+#endif
+        mCover = new float[width + 1];
+        memset(mCover, 0, (width + 1) * sizeof(float));
+        mWidth = width;
+        mHeight = height;
+    }
+#ifdef MIT_SHM
+    if (mShmPending) {
+        // wait until the server has finished reading the last frame
+        XSync(mDpy, False);
+        mShmPending = 0;
+    }
+#endif
+    mCoverMin = mWidth;
+    mCoverMax = -1;
+    mRaster = 1;
+    return(1);
+}
+
+void PDrawRaster::EndDrawing()
+{
+    mRaster = 0;
+    // bring the window drawable up to date with our drawing state
+    mDirect->SetForegroundPixel(mPixel, mAlpha >= 256 ? 0xffff : mAlpha * 0xffff / 256);
+    if (GetFont()) mDirect->SetFont(GetFont());
+#ifdef ANTI_ALIAS
+    if (GetXftFont()) mDirect->PDrawable::SetFont(GetXftFont());
+    mDirect->SetSmoothText(IsSmoothText() ? 1 : 0);
+    mDirect->SetSmoothLines(IsSmoothLines());
+#endif
+    mDirect->SetLineWidth(mLineWidth);
+    if (mDash) mDirect->SetLineType(kLineTypeOnOffDash);
+    mDirect->EndDrawing();
+}
+
+//---------------------------------------------------------------------------------------
+// Drawing state
+// - while rasterising, the state is only passed to the window drawable in EndDrawing()
+//   (setting the X foreground colour may need a round trip to the server)
+//
+void PDrawRaster::SetForeground(int col_num, int alpha)
+{
+    SetForegroundPixel(mColours ? mColours[col_num] : mDirect->GetColourPixel(col_num), alpha);
+}
+
+void PDrawRaster::SetForegroundPixel(Pixel pixel, int alpha)
+{
+    mPixel = (uint32_t)pixel;
+    mAlpha = (alpha >= 0xffff) ? 256 : (alpha * 256 + 0x7fff) / 0xffff;
+    if (!mRaster) mDirect->SetForegroundPixel(pixel, alpha);
+}
+
+void PDrawRaster::SetFont(XFontStruct *font)
+{
+    PDrawable::SetFont(font);
+    if (!mRaster) mDirect->SetFont(font);
+}
+
+#ifdef ANTI_ALIAS
+void PDrawRaster::SetFont(XftFont *font)
+{
+    PDrawable::SetFont(font);
+    if (!mRaster) mDirect->PDrawable::SetFont(font);
+}
+
+void PDrawRaster::SetSmoothText(int on)
+{
+    PDrawable::SetSmoothText(on);
+    mDirect->SetSmoothText(on);
+}
+
+void PDrawRaster::SetSmoothLines(int on)
+{
+    PDrawable::SetSmoothLines(on);
+    mDirect->SetSmoothLines(on);
+}
+#endif
+
+void PDrawRaster::SetLineWidth(float width)
+{
+    mLineWidth = width;
+    mDash = 0;
+    if (!mRaster) mDirect->SetLineWidth(width);
+}
+
+void PDrawRaster::SetLineType(ELineType type)
+{
+    if (type == kLineTypeOnOffDash) mDash = 1;
+    if (!mRaster) mDirect->SetLineType(type);
+}
+
+int PDrawRaster::GetTextWidth(char *str)
+{
+    int width;
+#ifdef ANTI_ALIAS
+    if (IsSmoothText()) {
+        XGlyphInfo    extents;
+        XftTextExtents8(mDpy, GetXftFont(), (XftChar8 *)str, strlen(str), &extents );
+        width = extents.width - extents.x;
+    } else {
+#endif
+    width = GetFont() ? XTextWidth(GetFont(), str, strlen(str)) : 0;
+#ifdef ANTI_ALIAS
+    }
+#endif
+    return(width);
+}
+
+//---------------------------------------------------------------------------------------
+// Scan conversion
+//
+
+// fill pixels x1 to x2-1 of row y
+void PDrawRaster::FillSpan(int y, int x1, int x2)
+{
+    if (y < 0 || y >= mHeight) return;
+    if (x1 < 0) x1 = 0;
+    if (x2 > mWidth) x2 = mWidth;
+    if (x1 >= x2) return;
+    uint32_t *p = mBuff + y * mWidth + x1;
+    if (mAlpha >= 256) {
+        fillSpan(p, x2 - x1, mPixel);
+    } else {
+        blendSpan(p, x2 - x1, mPixel, mAlpha, mMask);
+    }
+}
+
+void PDrawRaster::PlotPixel(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= mWidth || y >= mHeight) return;
+    uint32_t *p = mBuff + y * mWidth + x;
+    *p = (mAlpha >= 256) ? mPixel : blendPixel(*p, mPixel, mAlpha, mMask);
+}
+
+// draw a zero-width line, including both end points
+void PDrawRaster::ThinLine(int x1, int y1, int x2, int y2)
+{
+    int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+    int dy = -abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+    int err = dx + dy;
+    for (int n=0; ; ++n) {
+        if (!mDash || (n / kDashLen) % 2 == 0) PlotPixel(x1, y1);
+        if (x1 == x2 && y1 == y2) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x1 += sx; }
+        if (e2 <= dx) { err += dx; y1 += sy; }
+    }
+}
+
+// draw a line of the current width between two pixel centres
+void PDrawRaster::WideLine(double x1, double y1, double x2, double y2, int aa)
+{
+    double px[4], py[4];
+    double dx = x2 - x1;
+    double dy = y2 - y1;
+    double len = sqrt(dx*dx + dy*dy);
+    double w = mLineWidth < 1 ? 1 : mLineWidth;
+    if (!len) return;
+    double ldx = (w / 2.0) * dy / len;
+    double ldy = (w / 2.0) * dx / len;
+
+    px[0] = x1 + ldx + 0.5;  py[0] = y1 - ldy + 0.5;
+    px[1] = x2 + ldx + 0.5;  py[1] = y2 - ldy + 0.5;
+    px[2] = x2 - ldx + 0.5;  py[2] = y2 + ldy + 0.5;
+    px[3] = x1 - ldx + 0.5;  py[3] = y1 + ldy + 0.5;
+    FillPoly(px, py, 4, aa);
+}
+
+// add coverage for the part of the current row from xa to xb
+void PDrawRaster::AddCoverage(double xa, double xb, double w)
+{
+    if (xa < 0) xa = 0;
+    if (xb > mWidth) xb = mWidth;
+    if (xb <= xa) return;
+    int ia = (int)xa;
+    int ib = (int)xb;
+    if (ia < mCoverMin) mCoverMin = ia;
+    if (ib > mCoverMax) mCoverMax = ib;
+    if (ia == ib) {
+        mCover[ia] += (float)((xb - xa) * w);
+        return;
+    }
+    mCover[ia] += (float)((ia + 1 - xa) * w);
+    for (int i=ia+1; i<ib; ++i) {
+        mCover[i] += (float)w;
+    }
+    mCover[ib] += (float)((xb - ib) * w);
+}
+
+// blend the current colour through a coverage map (0-255) with top left at x0,y0
+void PDrawRaster::BlendCoverage(int x0, int y0, const unsigned char *cover, int w, int h)
+{
+    for (int j=0; j<h; ++j, cover+=w) {
+        int yd = y0 + j;
+        if (yd < 0 || yd >= mHeight) continue;
+        uint32_t *row = mBuff + yd * mWidth;
+        for (int i=0; i<w; ++i) {
+            int xd = x0 + i;
+            if (!cover[i] || xd < 0 || xd >= mWidth) continue;
+            int a = (cover[i] * mAlpha + 127) / 255;
+            row[xd] = (a >= 256) ? mPixel : blendPixel(row[xd], mPixel, a, mMask);
+        }
+    }
+}
+
+// blend the accumulated coverage into row y
+void PDrawRaster::FlushCoverage(int y)
+{
+    if (mCoverMax >= mWidth) mCoverMax = mWidth - 1;
+    uint32_t *row = mBuff + y * mWidth;
+    for (int x=mCoverMin; x<=mCoverMax; ++x) {
+        float c = mCover[x];
+        if (c <= 0) continue;
+        mCover[x] = 0;
+        int a = (int)(c * mAlpha + 0.5);
+        if (a >= 256) {
+            row[x] = mPixel;
+        } else if (a > 0) {
+            row[x] = blendPixel(row[x], mPixel, a, mMask);
+        }
+    }
+    mCover[mWidth] = 0;
+    mCoverMin = mWidth;
+    mCoverMax = -1;
+}
+
+/*
+** Fill a polygon (even-odd rule)
+** - pixel (x,y) covers the square from x,y to x+1,y+1
+** - without anti-aliasing, pixels are filled if their centre is inside
+** - with anti-aliasing, the coverage is found from kAASub sub-scanlines per row
+*/
+void PDrawRaster::FillPoly(const double *px, const double *py, int num, int aa)
+{
+    if (num < 3) return;        // (nothing to fill)
+
+    double  xbuf[kMaxPolyPoints];
+    double  *xs = num > kMaxPolyPoints ? new double[num] : xbuf;
+    double  ymin = py[0], ymax = py[0];
+    int     i, j, k, n, y, y1, y2, s;
+
+    for (i=1; i<num; ++i) {
+        if (ymin > py[i]) ymin = py[i];
+        if (ymax < py[i]) ymax = py[i];
+    }
+    if (aa) {
+        y1 = (int)floor(ymin);
+        y2 = (int)ceil(ymax) - 1;
+    } else {
+        y1 = (int)ceil(ymin - 0.5);
+        y2 = (int)floor(ymax - 0.5);
+    }
+    if (y1 < 0) y1 = 0;
+    if (y2 >= mHeight) y2 = mHeight - 1;
+
+    for (y=y1; y<=y2; ++y) {
+        for (s=0; s<(aa ? kAASub : 1); ++s) {
+            double yc = aa ? y + (s + 0.5) / kAASub : y + 0.5;
+            // find the edge crossings on this scanline
+            for (i=0, j=num-1, n=0; i<num; j=i++) {
+                if ((py[i] > yc) == (py[j] > yc)) continue;
+                double x = px[i] + (yc - py[i]) * (px[j] - px[i]) / (py[j] - py[i]);
+                // insertion sort (there are very few crossings)
+                for (k=n++; k>0 && xs[k-1]>x; --k) xs[k] = xs[k-1];
+                xs[k] = x;
+            }
+            for (k=0; k+1<n; k+=2) {
+                if (aa) {
+                    AddCoverage(xs[k], xs[k+1], 1.0 / kAASub);
+                } else {
+                    FillSpan(y, (int)ceil(xs[k] - 0.5), (int)ceil(xs[k+1] - 0.5));
+                }
+            }
+        }
+        if (aa) FlushCoverage(y);
+    }
+    if (xs != xbuf) delete [] xs;
+}
+
+// calculate the points along an arc (returns the number of points)
+// - angles are in degrees counterclockwise from 3 o'clock, as for XDrawArc()
+// - px and py must have room for kMaxArcPoints+1 points
+int PDrawRaster::ArcPoints(double cx, double cy, double rx, double ry,
+                           float ang1, float ang2, double *px, double *py)
+{
+    if (ang2 > 360) ang2 = 360;
+    if (ang2 < -360) ang2 = -360;
+    int num = (int)((rx + ry) * fabs(ang2) / 360);
+    if (num < kMinArcPoints) num = kMinArcPoints;
+    if (num > kMaxArcPoints) num = kMaxArcPoints;
+    double ang = ang1 * PI / 180;
+    double step = ang2 * PI / 180 / num;
+    for (int i=0; i<=num; ++i, ang+=step) {
+        px[i] = cx + rx * cos(ang);
+        py[i] = cy - ry * sin(ang);
+    }
+    return(num + 1);
+}
+
+// get the glyph cache for the current font
+RasterFont *PDrawRaster::GetRasterFont()
+{
+    void *id;
+    int smooth = 0;
+#ifdef ANTI_ALIAS
+    if (IsSmoothText()) {
+        id = GetXftFont();
+        smooth = 1;
+    } else
+#endif
+    id = GetFont();
+    if (!id) return(NULL);
+
+    for (RasterFont *font=mFonts; font; font=font->next) {
+        if (font->id == id && font->smooth == smooth) return(font);
+    }
+    RasterFont *font = new RasterFont;
+    memset(font, 0, sizeof(RasterFont));
+    font->id = id;
+    font->smooth = smooth;
+    font->next = mFonts;
+    mFonts = font;
+    return(font);
+}
+
+//---------------------------------------------------------------------------------------
+// Drawing primitives
+//
+void PDrawRaster::DrawSegments(XSegment *segments, int num, int smooth)
+{
+    if (!mRaster) {
+        mDirect->DrawSegments(segments, num, smooth);
+        return;
+    }
+    int aa = smooth && IsSmoothLines();
+    XSegment *sp = segments;
+    for (int i=0; i<num; ++i, ++sp) {
+        if (aa && sp->x1 != sp->x2 && sp->y1 != sp->y2) {
+            WideLine(sp->x1, sp->y1, sp->x2, sp->y2, 1);
+        } else if (mLineWidth > 1) {
+            WideLine(sp->x1, sp->y1, sp->x2, sp->y2, 0);
+        } else {
+            ThinLine(sp->x1, sp->y1, sp->x2, sp->y2);
+        }
+    }
+}
+
+void PDrawRaster::DrawPoint(int x, int y)
+{
+    if (!mRaster) {
+        mDirect->DrawPoint(x, y);
+        return;
+    }
+    PlotPixel(x, y);
+}
+
+void PDrawRaster::DrawLine(int x1,int y1,int x2,int y2)
+{
+    if (!mRaster) {
+        mDirect->DrawLine(x1, y1, x2, y2);
+        return;
+    }
+    XSegment seg;
+    seg.x1 = x1;
+    seg.y1 = y1;
+    seg.x2 = x2;
+    seg.y2 = y2;
+    DrawSegments(&seg, 1);
+}
+
+void PDrawRaster::DrawRectangle(int x,int y,int w,int h)
+{
+    if (!mRaster) {
+        mDirect->DrawRectangle(x, y, w, h);
+        return;
+    }
+    XSegment seg[4];
+    seg[0].x1 = x;      seg[0].y1 = y;      seg[0].x2 = x + w;  seg[0].y2 = y;
+    seg[1].x1 = x + w;  seg[1].y1 = y;      seg[1].x2 = x + w;  seg[1].y2 = y + h;
+    seg[2].x1 = x + w;  seg[2].y1 = y + h;  seg[2].x2 = x;      seg[2].y2 = y + h;
+    seg[3].x1 = x;      seg[3].y1 = y + h;  seg[3].x2 = x;      seg[3].y2 = y;
+    DrawSegments(seg, 4, 0);
+}
+
+void PDrawRaster::FillRectangle(int x,int y,int w,int h)
+{
+    if (!mRaster) {
+        mDirect->FillRectangle(x, y, w, h);
+        return;
+    }
+    if (y < 0) { h += y; y = 0; }
+    if (y + h > mHeight) h = mHeight - y;
+    for (int i=0; i<h; ++i) {
+        FillSpan(y + i, x, x + w);
+    }
+}
+
+void PDrawRaster::FillRectangles(XRectangle *rects, int num)
+{
+    if (!mRaster) {
+        mDirect->FillRectangles(rects, num);
+        return;
+    }
+    for (int i=0; i<num; ++i) {
+        FillRectangle(rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+    }
+}
+
+void PDrawRaster::FillPolygon(XPoint *point, int num)
+{
+    if (!mRaster) {
+        mDirect->FillPolygon(point, num);
+        return;
+    }
+    if (num < 3) return;
+    double  pbuf[2 * kMaxPolyPoints];
+    double  *px = num > kMaxPolyPoints ? new double[2 * num] : pbuf;
+    double  *py = px + num;
+    int     i = 0;
+    // (a do-while so GCC can see that pbuf is written before FillPoly reads it)
+    do {
+        px[i] = point[i].x;
+        py[i] = point[i].y;
+    } while (++i < num);
+    FillPoly(px, py, num, 0);
+    if (px != pbuf) delete [] px;
+}
+
+void PDrawRaster::DrawArc(int cx,int cy,int rx,int ry,float ang1,float ang2)
+{
+    if (!mRaster) {
+        mDirect->DrawArc(cx, cy, rx, ry, ang1, ang2);
+        return;
+    }
+    double px[kMaxArcPoints+1], py[kMaxArcPoints+1];
+    int num = ArcPoints(cx, cy, rx, ry, ang1, ang2, px, py);
+    int aa = IsSmoothLines();
+    for (int i=1; i<num; ++i) {
+        if (aa || mLineWidth > 1) {
+            WideLine(px[i-1], py[i-1], px[i], py[i], aa);
+        } else {
+            ThinLine((int)floor(px[i-1] + 0.5), (int)floor(py[i-1] + 0.5),
+                     (int)floor(px[i] + 0.5), (int)floor(py[i] + 0.5));
+        }
+    }
+}
+
+// fill an arc (a pie slice unless the arc is a full ellipse)
+// - like XFillArc, the ellipse covers the pixels from cx-rx to cx+rx
+void PDrawRaster::FillArc(int cx,int cy,int rx,int ry,float ang1,float ang2)
+{
+    if (!mRaster) {
+        mDirect->FillArc(cx, cy, rx, ry, ang1, ang2);
+        return;
+    }
+    double px[kMaxArcPoints+2], py[kMaxArcPoints+2];
+    int num = ArcPoints(cx + 0.5, cy + 0.5, rx + 0.5, ry + 0.5, ang1, ang2, px, py);
+    if (ang2 > -360 && ang2 < 360) {
+        px[num] = cx + 0.5;
+        py[num] = cy + 0.5;
+        ++num;
+    }
+    FillPoly(px, py, num, IsSmoothLines());
+}
+
+void PDrawRaster::FillArcs(XArc *arcs, int num)
+{
+    if (!mRaster) {
+        mDirect->FillArcs(arcs, num);
+        return;
+    }
+    PDrawable::FillArcs(arcs, num);
+}
+
+// fill square or circle markers (circles are stamped from cached sprites)
+void PDrawRaster::FillMarkers(XPoint *points, int num, int size, int circles)
+{
+    if (!mRaster) {
+        mDirect->FillMarkers(points, num, size, circles);
+        return;
+    }
+    if (!circles || size < 0 || size > kMaxMarkerRadius) {
+        PDrawable::FillMarkers(points, num, size, circles);
+        return;
+    }
+    int aa = IsSmoothLines() ? 1 : 0;
+    int dim = size * 2 + 1;
+    unsigned char *sprite = mSprite[aa][size];
+    if (!sprite) {
+        sprite = mSprite[aa][size] = new unsigned char[dim * dim];
+        GetMarkerSprite(sprite, size, dim, aa);
+    }
+    for (int i=0; i<num; ++i) {
+        BlendCoverage(points[i].x - size, points[i].y - size, sprite, dim, dim);
+    }
+}
+
+void PDrawRaster::DrawString(int x, int y, char *str, ETextAlign_q align)
+{
+    if (!mRaster) {
+        mDirect->DrawString(x, y, str, align);
+        return;
+    }
+    RasterFont *font = GetRasterFont();
+    if (!font) return;
+
+    switch (align / 3) {
+        case 0:     // top
+            y += GetFontAscent();
+            break;
+        case 1:     // middle
+            y += GetFontAscent() / 2;
+            break;
+        case 2:     // bottom
+            break;
+    }
+    if (align % 3) {
+        int len = strlen(str);
+        int width;
+#ifdef ANTI_ALIAS
+        if (font->smooth) {
+            XGlyphInfo  extents;
+            XftTextExtents8(mDpy, GetXftFont(), (XftChar8 *)str, len, &extents);
+            width = extents.width;
+        } else
+#endif
+        width = XTextWidth(GetFont(), str, len);
+        x -= (align % 3 == 1) ? width / 2 : width;
+    }
+    if (font->smooth) --x;   // (same offset as PDrawXPixmap)
+
+    for (unsigned char *cp=(unsigned char *)str; *cp; ++cp) {
+        RasterGlyph *glyph = font->glyph[*cp];
+        if (!glyph) {
+#ifdef ANTI_ALIAS
+            if (font->smooth) {
+                glyph = loadXftGlyph((XftFont *)font->id, *cp);
+            } else
+#endif
+            glyph = loadCoreGlyph(mDpy, (XFontStruct *)font->id, *cp);
+            font->glyph[*cp] = glyph;
+        }
+        if (glyph->cover) {
+            BlendCoverage(x + glyph->left, y - glyph->top, glyph->cover,
+                          glyph->width, glyph->height);
+        }
+        x += glyph->advance;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Images and layers
+//
+void PDrawRaster::PutImage(XImage *image, int dest_x, int dest_y)
+{
+    if (!mRaster) {
+        mDirect->PutImage(image, dest_x, dest_y);
+        return;
+    }
+    for (int y=0; y<image->height; ++y) {
+        int yd = dest_y + y;
+        if (yd < 0 || yd >= mHeight) continue;
+        for (int x=0; x<image->width; ++x) {
+            int xd = dest_x + x;
+            if (xd < 0 || xd >= mWidth) continue;
+            mBuff[yd * mWidth + xd] = (uint32_t)XGetPixel(image, x, y);
+        }
+    }
+}
+
+XImage* PDrawRaster::GetImage(int x, int y, int width, int height)
+{
+    if (!mImage) return(NULL);
+    return(XSubImage(mImage, x, y, width, height));
+}
+
+// send part of the raster to a window
+int PDrawRaster::CopyArea(int x,int y,int w,int h,Window dest)
+{
+    if (!mImage) return(0);
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > mWidth) w = mWidth - x;
+    if (y + h > mHeight) h = mHeight - y;
+    if (w > 0 && h > 0) {
+#ifdef MIT_SHM
+        if (mShm) {
+            XShmPutImage(mDpy, dest, mGC, mImage, x, y, x, y, w, h, False);
+            mShmPending = 1;
+        } else
+#endif
+        XPutImage(mDpy, dest, mGC, mImage, x, y, x, y, w, h);
+    }
+    return(1);
+}
+
+int PDrawRaster::HasPixmap()
+{
+    return(mBuff != NULL);
+}
+
+int PDrawRaster::SaveLayer(int n)
+{
+    if (!mBuff || n < 0 || n >= kMaxDrawLayers) return(0);
+    size_t size = mWidth * mHeight * sizeof(uint32_t);
+    if (!mLayer[n]) {
+        mLayer[n] = (uint32_t *)malloc(size);
+        if (!mLayer[n]) return(0);
+    }
+    memcpy(mLayer[n], mBuff, size);
+    return(1);
+}
+
+int PDrawRaster::RestoreLayer(int n)
+{
+    if (!mBuff || n < 0 || n >= kMaxDrawLayers || !mLayer[n]) return(0);
+    memcpy(mBuff, mLayer[n], mWidth * mHeight * sizeof(uint32_t));
+    return(1);
+}
@@ -0,0 +1,120 @@
+//==============================================================================
+// File:        PDrawRaster.h
+//
+// Description: Drawing routines for a client-side raster image
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PDrawRaster_h__
+#define __PDrawRaster_h__
+
+#include <stdint.h>
+#include "PDrawable.h"
+#ifdef MIT_SHM
+#include <X11/extensions/XShm.h>
+#endif
+
+class PDrawXPixmap;
+struct RasterFont;
+
+/*
+** Drawable that rasterises into a 32-bit image in client memory, and sends
+** the finished frame to the window with a single XPutImage in CopyArea().
+** This avoids one X request per primitive when the display is remote.
+** After EndDrawing(), drawing goes straight to the window through an
+** ordinary PDrawXPixmap (for the cursor drawn by AfterDrawing()).
+** Requires a TrueColor visual with 32 bits per pixel (see IsSupported()).
+** With MIT_SHM, the image is kept in shared memory when the server is local.
+*/
+class PDrawRaster : public PDrawable
+{
+public:
+    PDrawRaster(Display *dpy, GC gc, int depth, Widget w);
+    virtual ~PDrawRaster();
+
+    static int      IsSupported(Display *dpy, int depth);
+
+    virtual int     BeginDrawing(int width,int height);
+    virtual void    EndDrawing();
+
+    virtual void    SetForeground(int col_num, int alpha=0xffff);
+    virtual void    SetForegroundPixel(Pixel pixel, int alpha=0xffff);
+    virtual void    SetFont(XFontStruct *font);
+#ifdef ANTI_ALIAS
+    virtual void    SetFont(XftFont *font);
+    virtual void    SetSmoothText(int on);
+    virtual void    SetSmoothLines(int on);
+#endif
+    virtual void    SetLineWidth(float width);
+    virtual void    SetLineType(ELineType type);
+    virtual int     GetTextWidth(char *str);
+    virtual void    DrawSegments(XSegment *segments, int num, int smooth=1);
+    virtual void    DrawPoint(int x,int y);
+    virtual void    DrawLine(int x1,int y1,int x2,int y2);
+    virtual void    DrawRectangle(int x,int y,int w,int h);
+    virtual void    FillRectangle(int x,int y,int w,int h);
+    virtual void    FillPolygon(XPoint *point, int num);
+    virtual void    DrawString(int x, int y, char *str,ETextAlign_q align);
+    virtual void    DrawArc(int cx,int cy,int rx,int ry,float ang1,float ang2);
+    virtual void    FillArc(int cx,int cy,int rx,int ry,float ang1,float ang2);
+    virtual void    FillRectangles(XRectangle *rects, int num);
+    virtual void    FillArcs(XArc *arcs, int num);
+    virtual void    FillMarkers(XPoint *points, int num, int size, int circles);
+
+    virtual void    PutImage(XImage *image, int dest_x, int dest_y);
+    virtual XImage* GetImage(int x, int y, int width, int height);
+    virtual int     CopyArea(int x,int y,int w,int h,Window dest);
+    virtual int     HasPixmap();
+    virtual int     SaveLayer(int n);
+    virtual int     RestoreLayer(int n);
+
+    virtual EDevice GetDeviceType()     { return kDeviceVideo; }
+
+private:
+    void            FreeImage();
+    void            FillSpan(int y, int x1, int x2);
+    void            PlotPixel(int x, int y);
+    void            ThinLine(int x1, int y1, int x2, int y2);
+    void            WideLine(double x1, double y1, double x2, double y2, int aa);
+    void            FillPoly(const double *px, const double *py, int num, int aa);
+    void            AddCoverage(double xa, double xb, double w);
+    void            FlushCoverage(int y);
+    void            BlendCoverage(int x0, int y0, const unsigned char *cover, int w, int h);
+    int             ArcPoints(double cx, double cy, double rx, double ry,
+                              float ang1, float ang2, double *px, double *py);
+    RasterFont    * GetRasterFont();
+#ifdef MIT_SHM
+    static int      ShmWorks(Display *dpy);
+    int             CreateShmImage(int width, int height);
+#endif
+
+    PDrawXPixmap  * mDirect;            // drawable for the window (after EndDrawing)
+    Display       * mDpy;               // X display
+    GC              mGC;                // X graphics context for XPutImage
+    Widget          mWidget;            // widget we draw into
+    int             mDepth;             // depth of screen
+    int             mRaster;            // non-zero while drawing into the raster
+    XImage        * mImage;             // X image wrapping mBuff
+    uint32_t      * mBuff;              // raster pixels (mWidth * mHeight)
+    uint32_t      * mLayer[kMaxDrawLayers]; // cached copies of the raster
+    float         * mCover;             // anti-aliasing coverage for one row
+    int             mCoverMin;          // range of columns with coverage
+    int             mCoverMax;
+    int             mWidth;             // raster width
+    int             mHeight;            // raster height
+    uint32_t        mPixel;             // current drawing pixel value
+    int             mAlpha;             // current alpha (0-256)
+    float           mLineWidth;         // current line width
+    int             mDash;              // non-zero for dashed thin lines
+    uint32_t        mMask[3];           // red, green and blue pixel masks
+    RasterFont    * mFonts;             // glyph caches for the fonts we have drawn
+    unsigned char * mSprite[2][kMaxMarkerRadius+1]; // circle marker coverage (aliased/smooth)
+#ifdef MIT_SHM
+    XShmSegmentInfo mShmInfo;           // shared memory segment for mImage
+    int             mShm;               // non-zero if mImage is in shared memory
+    int             mUseShm;            // non-zero to try shared memory images
+    int             mShmPending;        // non-zero if the server may still be reading mImage
+#endif
+};
+
+#endif // __PDrawRaster_h__
@@ -36,11 +36,20 @@ PDrawXPixmap::PDrawXPixmap(Display *dpy, GC gc, int depth, Widget w)
     mDepth = depth;
     mAltWidget = w; // widget to draw into if we can't create pixmap
     mPix = 0;
+    memset(mLayer, 0, sizeof(mLayer));
     mWidth = 0;
     mHeight = 0;
 #ifdef ANTI_ALIAS
     mLineWidth = 1.0;
     mXftDraw = mXftDrawPix = mXftDrawDpy = NULL;
+    mAlpha = 0xffff;
+    mXftPixel = 0;
+    mXftGeneration = 0;
+    mNumTris = 0;
+    mMarkerGlyphs = 0;
+    memset(mMarkerLoaded, 0, sizeof(mMarkerLoaded));
+    mMarkerElts = NULL;
+    mMaxMarkerElts = 0;
     mXftFmt = XRenderFindStandardFormat(dpy,PictStandardA8);
 #endif
 }
@@ -51,6 +60,8 @@ PDrawXPixmap::~PDrawXPixmap()
 #ifdef ANTI_ALIAS
     if (mXftDrawPix) XftDrawDestroy(mXftDrawPix);
     if (mXftDrawDpy) XftDrawDestroy(mXftDrawDpy);
+    if (mMarkerGlyphs) XRenderFreeGlyphSet(mDpy, mMarkerGlyphs);
+    delete [] mMarkerElts;
 #endif
 }
 
@@ -61,6 +72,9 @@ int PDrawXPixmap::BeginDrawing(int width, int height)
 {
     int     sizeChanged = 0;
     
+#ifdef ANTI_ALIAS
+    FlushSmoothLines();
+#endif
     if (mWidth != width || mHeight != height) {
         // free old pixmap since our size changed
         FreePixmap();
@@ -99,6 +113,9 @@ int PDrawXPixmap::BeginDrawing(int width, int height)
 
 void PDrawXPixmap::EndDrawing()
 {
+#ifdef ANTI_ALIAS
+    FlushSmoothLines();
+#endif
     // must draw directly to window since pixmap has already been copied
     mDrawable = XtWindow(mAltWidget);
 #ifdef ANTI_ALIAS
@@ -111,26 +128,155 @@ void PDrawXPixmap::EndDrawing()
 }
 
 #ifdef ANTI_ALIAS
+/*
+** Xft colours are cached for each pixel and alpha, and shared by all drawables.
+** LoadXftColours() queries every resource colour in a single request, so
+** SetForeground() normally doesn't need a round trip to the server.
+*/
+const int kXftCacheSize = 2048;         // size of colour hash table (power of 2)
+const int kXftPreload[] = { 0xffff, 0xc000, 0x8000 };   // alphas to load for each colour
+
+struct XftColourEntry {
+    Pixel       pixel;
+    int         alpha;
+    int         used;                   // non-zero if this entry is in use
+    XftColor    colour;
+};
+
+static XftColourEntry * sXftColours = NULL;
+static int              sNumXftColours = 0;
+static Display        * sXftDpy = NULL;
+static int              sXftGeneration = 1;     // incremented when colours are freed
+
+// find the cache entry for a pixel and alpha (returns an unused entry if not found)
+static XftColourEntry *findXftColour(Pixel pixel, int alpha)
+{
+    if (!sXftColours) {
+        sXftColours = new XftColourEntry[kXftCacheSize];
+        memset(sXftColours, 0, kXftCacheSize * sizeof(XftColourEntry));
+    }
+    unsigned h = ((unsigned)pixel * 2654435761U ^ (unsigned)alpha) & (kXftCacheSize - 1);
+    while (sXftColours[h].used && (sXftColours[h].pixel != pixel || sXftColours[h].alpha != alpha)) {
+        h = (h + 1) & (kXftCacheSize - 1);
+    }
+    return(sXftColours + h);
+}
+
+// allocate an Xft colour into the cache
+static XftColourEntry *addXftColour(Display *dpy, Pixel pixel, XRenderColor *xrcolor)
+{
+    if (sNumXftColours >= kXftCacheSize / 2) {
+        PDrawXPixmap::FreeXftColours();     // (table is full of odd colours)
+    }
+    XftColourEntry *entry = findXftColour(pixel, xrcolor->alpha);
+    if (!entry->used) {
+        XftColorAllocValue(dpy, DefaultVisual(dpy,DefaultScreen(dpy)),
+                           DefaultColormap(dpy, DefaultScreen(dpy)), xrcolor, &entry->colour);
+        entry->pixel = pixel;
+        entry->alpha = xrcolor->alpha;
+        entry->used = 1;
+        ++sNumXftColours;
+        sXftDpy = dpy;
+    }
+    return(entry);
+}
+
+// load the Xft colours for all resource colours
+// - must be called after the resource colours change
+void PDrawXPixmap::LoadXftColours()
+{
+    AgedResource &res = PResourceManager::sResource;
+    Display *dpy = res.display;
+    int num = NUM_COLOURS + res.num_cols + res.det_cols;
+    int i, j;
+
+    FreeXftColours();
+    if (!dpy) return;
+
+    XColor *cols = new XColor[num];
+    for (i=0; i<NUM_COLOURS; ++i) {
+        cols[i].pixel = res.colour[i];
+    }
+    for (i=0; i<res.num_cols; ++i) {
+        cols[NUM_COLOURS + i].pixel = res.scale_col[i];
+    }
+    for (i=0; i<res.det_cols; ++i) {
+        cols[NUM_COLOURS + res.num_cols + i].pixel = res.det_col[i];
+    }
+    XQueryColors(dpy, DefaultColormap(dpy,DefaultScreen(dpy)), cols, num);
+
+    for (i=0; i<num; ++i) {
+        for (j=0; j<(int)(sizeof(kXftPreload)/sizeof(int)); ++j) {
+            XRenderColor xrcolor;
+            xrcolor.red   = cols[i].red;
+            xrcolor.green = cols[i].green;
+            xrcolor.blue  = cols[i].blue;
+            xrcolor.alpha = kXftPreload[j];
+            addXftColour(dpy, cols[i].pixel, &xrcolor);
+        }
+    }
+    delete [] cols;
+}
+
+// free all cached Xft colours
+void PDrawXPixmap::FreeXftColours()
+{
+    if (!sXftColours) return;
+    for (int i=0; i<kXftCacheSize; ++i) {
+        if (sXftColours[i].used) {
+            XftColorFree(sXftDpy, DefaultVisual(sXftDpy,DefaultScreen(sXftDpy)),
+                         DefaultColormap(sXftDpy, DefaultScreen(sXftDpy)), &sXftColours[i].colour);
+        }
+    }
+    memset(sXftColours, 0, kXftCacheSize * sizeof(XftColourEntry));
+    sNumXftColours = 0;
+    ++sXftGeneration;
+}
+
 void PDrawXPixmap::SetXftColour(Pixel pixel, int alpha)
 {
-    if (mDpy) {
-        XColor c;
-        c.pixel = pixel;
-        XQueryColor(mDpy, DefaultColormap(mDpy,DefaultScreen(mDpy)), &c);
+    if (!mDpy) return;
+    if (pixel == mXftPixel && alpha == mAlpha && mXftGeneration == sXftGeneration) return;
+
+    FlushSmoothLines();     // (batched lines are drawn in the old colour)
+
+    XftColourEntry *entry = findXftColour(pixel, alpha);
+    if (!entry->used) {
         XRenderColor xrcolor;
-        xrcolor.red   = c.red;
-        xrcolor.green = c.green;
-        xrcolor.blue  = c.blue;
+        XftColourEntry *opaque = findXftColour(pixel, 0xffff);
+        if (opaque->used) {
+            // same colour with a different alpha
+            xrcolor = opaque->colour.color;
+        } else {
+            // not a resource colour, so we must ask the server
+            XColor c;
+            c.pixel = pixel;
+            XQueryColor(mDpy, DefaultColormap(mDpy,DefaultScreen(mDpy)), &c);
+            xrcolor.red   = c.red;
+            xrcolor.green = c.green;
+            xrcolor.blue  = c.blue;
+        }
         xrcolor.alpha = alpha;
-        XftColorAllocValue(mDpy, DefaultVisual(mDpy,DefaultScreen(mDpy)),
-                   DefaultColormap(mDpy, DefaultScreen(mDpy) ), &xrcolor, &mXftColor);
-        mAlpha = alpha;
+        entry = addXftColour(mDpy, pixel, &xrcolor);
     }
+    mXftColor = entry->colour;
+    mXftPixel = pixel;
+    mXftGeneration = sXftGeneration;
+    mAlpha = alpha;
 }
 #endif
 
 void PDrawXPixmap::FreePixmap()
 {
+#ifdef ANTI_ALIAS
+    mNumTris = 0;
+#endif
+    for (int i=0; i<kMaxDrawLayers; ++i) {
+        if (mLayer[i]) {
+            XFreePixmap(mDpy, mLayer[i]);
+            mLayer[i] = 0;
+        }
+    }
     if (mPix) {
         XFreePixmap(mDpy,mPix);
         mPix = 0;
@@ -151,7 +297,35 @@ int PDrawXPixmap::HasPixmap()
     return(mPix != 0);
 }
 
-void PDrawXPixmap::SetForeground(int col_num, int alpha)
+// copy the pixmap into the cache for layer n
+int PDrawXPixmap::SaveLayer(int n)
+{
+    if (!mPix || n < 0 || n >= kMaxDrawLayers) return(0);
+#ifdef ANTI_ALIAS
+    FlushSmoothLines();
+#endif
+    if (!mLayer[n]) {
+        mLayer[n] = XCreatePixmap(mDpy, DefaultRootWindow(mDpy), mWidth, mHeight, mDepth);
+        if (!mLayer[n]) return(0);
+    }
+    XCopyArea(mDpy, mPix, mLayer[n], mGC, 0, 0, mWidth, mHeight, 0, 0);
+    return(1);
+}
+
+// copy the cached layer n back into the pixmap
+// - the layer is valid until the pixmap size changes
+int PDrawXPixmap::RestoreLayer(int n)
+{
+    if (!mPix || n < 0 || n >= kMaxDrawLayers || !mLayer[n]) return(0);
+#ifdef ANTI_ALIAS
+    mNumTris = 0;   // (anything drawn since is overwritten)
+#endif
+    XCopyArea(mDpy, mLayer[n], mPix, mGC, 0, 0, mWidth, mHeight, 0, 0);
+    return(1);
+}
+
+// get the pixel value for a colour number
+Pixel PDrawXPixmap::GetColourPixel(int col_num)
 {
     Pixel pixel;
     if (mColours) {
@@ -165,6 +339,12 @@ void PDrawXPixmap::SetForeground(int col_num, int alpha)
     } else {
         pixel = WhitePixel(mDpy, DefaultScreen(mDpy));
     }
+    return(pixel);
+}
+
+void PDrawXPixmap::SetForeground(int col_num, int alpha)
+{
+    Pixel pixel = GetColourPixel(col_num);
     XSetForeground(mDpy, mGC, pixel);
 #ifdef ANTI_ALIAS
     SetXftColour(pixel, alpha);
@@ -251,6 +431,7 @@ void PDrawXPixmap::DrawSegments(XSegment *segments, int num, int smooth)
                 DrawSmoothLine(sp->x1, sp->y1, sp->x2, sp->y2);
             }
         }
+        if (mDrawable != mPix) FlushSmoothLines();
     } else {
 #endif
 
@@ -267,26 +448,46 @@ void PDrawXPixmap::DrawPoint(int x, int y)
 }
 
 #ifdef ANTI_ALIAS
+/*
+** Smooth lines are batched as pairs of triangles and drawn by FlushSmoothLines()
+** with one XRenderCompositeTriangles request.  Compositing the same colour in
+** any order gives the same result, so the batch only needs to be drawn before
+** the colour changes or the pixmap is copied somewhere.  Drawing directly to the
+** window is flushed at the end of each call.
+*/
 void PDrawXPixmap::DrawSmoothLine(double x1, double y1, double x2, double y2)
 {
-    XPointDouble poly[4];
     XDouble dx = x2 - x1;
     XDouble dy = y2 - y1;
     XDouble len = sqrt(dx*dx + dy*dy);
     XDouble ldx = (mLineWidth/2.0) * dy / len;
     XDouble ldy = (mLineWidth/2.0) * dx / len;
 
-    poly[0].x = x1 + ldx + 0.5;  poly[0].y = y1 - ldy + 0.5;
-    poly[1].x = x2 + ldx + 0.5;  poly[1].y = y2 - ldy + 0.5;
-    poly[2].x = x2 - ldx + 0.5;  poly[2].y = y2 + ldy + 0.5;
-    poly[3].x = x1 - ldx + 0.5;  poly[3].y = y1 + ldy + 0.5;
+    if (mNumTris + 2 > kMaxSmoothTris) FlushSmoothLines();
 
-    XRenderCompositeDoublePoly(mDpy,
-                              PictOpOver,
-                              XftDrawSrcPicture(mXftDraw, &mXftColor),
-                              mXftPicture,
-                              mXftFmt,
-                              0, 0, 0, 0, poly, 4, EvenOddRule);
+    XTriangle *tri = mTris + mNumTris;
+    tri[0].p1.x = XDoubleToFixed(x1 + ldx + 0.5);  tri[0].p1.y = XDoubleToFixed(y1 - ldy + 0.5);
+    tri[0].p2.x = XDoubleToFixed(x2 + ldx + 0.5);  tri[0].p2.y = XDoubleToFixed(y2 - ldy + 0.5);
+    tri[0].p3.x = XDoubleToFixed(x2 - ldx + 0.5);  tri[0].p3.y = XDoubleToFixed(y2 + ldy + 0.5);
+    tri[1].p1 = tri[0].p1;
+    tri[1].p2 = tri[0].p3;
+    tri[1].p3.x = XDoubleToFixed(x1 - ldx + 0.5);  tri[1].p3.y = XDoubleToFixed(y1 + ldy + 0.5);
+    mNumTris += 2;
+}
+
+// draw the batched smooth lines
+void PDrawXPixmap::FlushSmoothLines()
+{
+    if (!mNumTris) return;
+    if (mXftDraw) {
+        XRenderCompositeTriangles(mDpy,
+                                  PictOpOver,
+                                  XftDrawSrcPicture(mXftDraw, &mXftColor),
+                                  mXftPicture,
+                                  mXftFmt,
+                                  0, 0, mTris, mNumTris);
+    }
+    mNumTris = 0;
 }
 #endif
 
@@ -301,6 +502,7 @@ void PDrawXPixmap::DrawLine(int x1,int y1,int x2,int y2)
 #ifdef ANTI_ALIAS
     } else {
         DrawSmoothLine(x1, y1, x2, y2);
+        if (mDrawable != mPix) FlushSmoothLines();
     }
 #endif
 }
@@ -446,6 +648,7 @@ void PDrawXPixmap::DrawArc(int cx,int cy,int rx,int ry,float ang1,float ang2)
                 double y2 = cy + ry * sin(ang + halfPix);
                 DrawSmoothLine(x1,y1,x2,y2);
             }
+            if (mDrawable != mPix) FlushSmoothLines();
         }
     } else {
 #endif
@@ -475,12 +678,27 @@ void PDrawXPixmap::FillArc(int cx,int cy,int rx,int ry,float ang1,float ang2)
             poly[i].x = cxd + rxd * cos(ang);
             poly[i].y = cyd + ryd * sin(ang);
         }
-        XRenderCompositeDoublePoly(mDpy,
-                              PictOpOver,
-                              XftDrawSrcPicture(mXftDraw, &mXftColor),
-                              mXftPicture,
-                              mXftFmt,
-                              0, 0, 0, 0, poly, num, EvenOddRule);
+        if (mAlpha == 0xffff) {
+            // batch opaque arcs as a triangle fan with the smooth lines
+            // (overlaps would be composited differently if translucent)
+            if (mNumTris + num > kMaxSmoothTris) FlushSmoothLines();
+            XTriangle *tri = mTris + mNumTris;
+            for (int i=0; i<num; ++i, ++tri) {
+                int j = (i + 1) % num;
+                tri->p1.x = XDoubleToFixed(cxd);        tri->p1.y = XDoubleToFixed(cyd);
+                tri->p2.x = XDoubleToFixed(poly[i].x);  tri->p2.y = XDoubleToFixed(poly[i].y);
+                tri->p3.x = XDoubleToFixed(poly[j].x);  tri->p3.y = XDoubleToFixed(poly[j].y);
+            }
+            mNumTris += num;
+            if (mDrawable != mPix) FlushSmoothLines();
+        } else {
+            XRenderCompositeDoublePoly(mDpy,
+                                  PictOpOver,
+                                  XftDrawSrcPicture(mXftDraw, &mXftColor),
+                                  mXftPicture,
+                                  mXftFmt,
+                                  0, 0, 0, 0, poly, num, EvenOddRule);
+        }
     } else {
 #endif
 
@@ -491,19 +709,143 @@ void PDrawXPixmap::FillArc(int cx,int cy,int rx,int ry,float ang1,float ang2)
 #endif
 }
 
+// Fill rectangles in current colour with a single request
+void PDrawXPixmap::FillRectangles(XRectangle *rects, int num)
+{
+#ifdef ANTI_ALIAS
+    if (IsSmoothLines() && mAlpha != 0xffff) {
+        // (translucent rectangles are composited individually)
+        PDrawable::FillRectangles(rects, num);
+        return;
+    }
+#endif
+    XFillRectangles(mDpy, mDrawable, mGC, rects, num);
+}
+
+// Fill arcs in current colour with a single request
+void PDrawXPixmap::FillArcs(XArc *arcs, int num)
+{
+#ifdef ANTI_ALIAS
+    if (IsSmoothLines()) {
+        // (smooth arcs are composited individually)
+        PDrawable::FillArcs(arcs, num);
+        return;
+    }
+#endif
+    XFillArcs(mDpy, mDrawable, mGC, arcs, num);
+}
+
+#ifdef ANTI_ALIAS
+// add the sprite for a smooth circle marker to our glyph set if necessary
+// - returns zero if the marker is too big for a sprite
+int PDrawXPixmap::LoadMarkerSprite(int radius)
+{
+    if (radius < 0 || radius > kMaxMarkerRadius || !mXftFmt) return(0);
+    if (mMarkerLoaded[radius]) return(1);
+    if (!mMarkerGlyphs) {
+        mMarkerGlyphs = XRenderCreateGlyphSet(mDpy, mXftFmt);
+        if (!mMarkerGlyphs) return(0);
+    }
+    int size = radius * 2 + 1;
+    int stride = (size + 3) & ~3;       // (glyph rows are padded to 32 bits)
+    char *buff = new char[stride * size];
+    memset(buff, 0, stride * size);
+    GetMarkerSprite((unsigned char *)buff, radius, stride, 1);
+
+    XGlyphInfo info;
+    info.width = info.height = size;
+    info.x = info.y = radius;           // glyph origin is the marker centre
+    info.xOff = info.yOff = 0;          // (no advance, so each element gives a position)
+    Glyph id = radius;
+    XRenderAddGlyphs(mDpy, mMarkerGlyphs, &id, &info, 1, buff, stride * size);
+    delete [] buff;
+    mMarkerLoaded[radius] = 1;
+    return(1);
+}
+#endif
+
+// Fill square or circle markers in current colour with a single request
+// - smooth circles are stamped from a sprite instead of being drawn as polygons
+void PDrawXPixmap::FillMarkers(XPoint *points, int num, int size, int circles)
+{
+    const int kChunk = 256;
+    int i, j, n;
+
+#ifdef ANTI_ALIAS
+    if (circles && IsSmoothLines() && LoadMarkerSprite(size)) {
+        if (mMaxMarkerElts < num) {
+            delete [] mMarkerElts;
+            mMaxMarkerElts = num + kChunk;
+            mMarkerElts = new XGlyphElt8[mMaxMarkerElts];
+        }
+        char id = (char)size;
+        int x = 0, y = 0;
+        for (i=0; i<num; ++i) {
+            mMarkerElts[i].glyphset = mMarkerGlyphs;
+            mMarkerElts[i].chars = &id;
+            mMarkerElts[i].nchars = 1;
+            mMarkerElts[i].xOff = points[i].x - x;
+            mMarkerElts[i].yOff = points[i].y - y;
+            x = points[i].x;
+            y = points[i].y;
+        }
+        XRenderCompositeText8(mDpy,
+                              PictOpOver,
+                              XftDrawSrcPicture(mXftDraw, &mXftColor),
+                              mXftPicture,
+                              0, 0, 0, 0, 0, mMarkerElts, num);
+        return;
+    }
+#endif
+    if (circles) {
+        XArc arcs[kChunk];
+        for (i=0; i<num; i+=n) {
+            n = num - i < kChunk ? num - i : kChunk;
+            for (j=0; j<n; ++j) {
+                arcs[j].x = points[i+j].x - size;
+                arcs[j].y = points[i+j].y - size;
+                arcs[j].width = arcs[j].height = size * 2 + 1;
+                arcs[j].angle1 = 0;
+                arcs[j].angle2 = 360 * 64;
+            }
+            FillArcs(arcs, n);
+        }
+    } else {
+        XRectangle rects[kChunk];
+        for (i=0; i<num; i+=n) {
+            n = num - i < kChunk ? num - i : kChunk;
+            for (j=0; j<n; ++j) {
+                rects[j].x = points[i+j].x - size;
+                rects[j].y = points[i+j].y - size;
+                rects[j].width = rects[j].height = size * 2 + 1;
+            }
+            FillRectangles(rects, n);
+        }
+    }
+}
+
 void PDrawXPixmap::PutImage(XImage *image, int dest_x, int dest_y)
 {
+#ifdef ANTI_ALIAS
+    FlushSmoothLines();
+#endif
     XPutImage(mDpy,mDrawable,mGC,image,0,0,dest_x,dest_y,image->width,image->height);
 }
 
 XImage* PDrawXPixmap::GetImage(int x, int y, int width, int height)
 {
+#ifdef ANTI_ALIAS
+    FlushSmoothLines();
+#endif
     return(XGetImage(mDpy,mDrawable,x,y,width,height,AllPlanes,ZPixmap));
 }
 
 int PDrawXPixmap::CopyArea(int x,int y,int w,int h,Window dest)
 {
     if (mPix) {
+#ifdef ANTI_ALIAS
+        FlushSmoothLines();
+#endif
         XCopyArea(mDpy,mPix,dest,mGC,x,y,w,h,x,y);
         return(1);
     } else {
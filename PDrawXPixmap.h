@@ -11,6 +11,10 @@
 
 #include "PDrawable.h"
 
+#ifdef ANTI_ALIAS
+const int kMaxSmoothTris = 512;         // maximum number of batched smooth line triangles
+#endif
+
 class PDrawXPixmap : public PDrawable
 {
 public:
@@ -20,6 +24,11 @@ public:
     virtual int     BeginDrawing(int width,int height);
     virtual void    EndDrawing();
     
+    Pixel           GetColourPixel(int col_num);
+#ifdef ANTI_ALIAS
+    static void     LoadXftColours();
+    static void     FreeXftColours();
+#endif
     virtual void    SetForeground(int col_num, int alpha=0xffff);
     virtual void    SetForegroundPixel(Pixel pixel, int alpha=0xffff);
     virtual void    SetFont(XFontStruct *font);
@@ -35,11 +44,16 @@ public:
     virtual void    DrawString(int x, int y, char *str,ETextAlign_q align);
     virtual void    DrawArc(int cx,int cy,int rx,int ry,float ang1,float ang2);
     virtual void    FillArc(int cx,int cy,int rx,int ry,float ang1,float ang2);
+    virtual void    FillRectangles(XRectangle *rects, int num);
+    virtual void    FillArcs(XArc *arcs, int num);
+    virtual void    FillMarkers(XPoint *points, int num, int size, int circles);
 
     virtual void    PutImage(XImage *image, int dest_x, int dest_y);
     virtual XImage* GetImage(int x, int y, int width, int height);  
     virtual int     CopyArea(int x,int y,int w,int h,Window dest);
     virtual int     HasPixmap();
+    virtual int     SaveLayer(int n);
+    virtual int     RestoreLayer(int n);
 
     virtual EDevice GetDeviceType()     { return kDeviceVideo; }        
         
@@ -48,6 +62,7 @@ private:
     void            FreePixmap();
     
     Pixmap          mPix;               // offscreen pixmap for drawing
+    Pixmap          mLayer[kMaxDrawLayers]; // cached images of the drawing layers
     Display       * mDpy;               // X display for drawing
     GC              mGC;                // X graphics context for drawing
     Widget          mAltWidget;         // widget to draw into if pixmap not available
@@ -58,6 +73,8 @@ private:
 
 #ifdef ANTI_ALIAS
     void            DrawSmoothLine(double x1, double y1, double x2, double y2);
+    void            FlushSmoothLines();
+    int             LoadMarkerSprite(int radius);
     void            SetXftColour(Pixel pixel, int alpha);
 
     XftDraw       * mXftDraw;           // current Xft drawable
@@ -68,6 +85,14 @@ private:
     Picture         mXftPicture;        // current Xft picture
     double          mLineWidth;         // current drawing line width
     int             mAlpha;             // current drawing alpha
+    Pixel           mXftPixel;          // pixel value of mXftColor
+    int             mXftGeneration;     // colour cache generation for mXftColor
+    XTriangle       mTris[kMaxSmoothTris]; // smooth line triangles waiting to be drawn
+    int             mNumTris;           // number of triangles in mTris
+    GlyphSet        mMarkerGlyphs;      // circle marker sprites (glyph number is radius)
+    char            mMarkerLoaded[kMaxMarkerRadius+1]; // flags for sprites in mMarkerGlyphs
+    XGlyphElt8    * mMarkerElts;        // glyph elements for stamping markers
+    int             mMaxMarkerElts;     // allocated size of mMarkerElts
 #endif
 };
 
@@ -0,0 +1,47 @@
+//==============================================================================
+// File:        PDrawable.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include "PDrawable.h"
+
+const int kMarkerSamples = 8;   // sub-pixel samples in each direction for marker sprites
+
+// Fill square or circle markers centred on the specified points
+// - size is the half-width of each marker in pixels
+// - derived classes may stamp these from cached sprites
+void PDrawable::FillMarkers(XPoint *points, int num, int size, int circles)
+{
+    for (int i=0; i<num; ++i) {
+        if (circles) {
+            FillArc(points[i].x, points[i].y, size, size, 0, 360);
+        } else {
+            FillRectangle(points[i].x - size, points[i].y - size, size * 2 + 1, size * 2 + 1);
+        }
+    }
+}
+
+// GetMarkerSprite - calculate the coverage (0-255) of each pixel of a circle marker
+// - the sprite is 2*radius+1 pixels square, with rows "stride" bytes apart
+// - the circle covers the same area as FillArc() with rx=ry=radius
+// - without anti-aliasing, pixels are covered if their centre is inside the circle
+void PDrawable::GetMarkerSprite(unsigned char *buff, int radius, int stride, int aa)
+{
+    int     size = radius * 2 + 1;
+    int     ns = aa ? kMarkerSamples : 1;
+    double  r = radius + 0.5;
+
+    for (int y=0; y<size; ++y) {
+        for (int x=0; x<size; ++x) {
+            int n = 0;
+            for (int j=0; j<ns; ++j) {
+                double dy = y + (j + 0.5) / ns - r;
+                for (int i=0; i<ns; ++i) {
+                    double dx = x + (i + 0.5) / ns - r;
+                    if (dx*dx + dy*dy < r*r) ++n;
+                }
+            }
+            buff[y * stride + x] = (unsigned char)((n * 255 + ns * ns / 2) / (ns * ns));
+        }
+    }
+}
@@ -41,6 +41,9 @@ enum ELineType {
     kLineTypeOnOffDash  // X11 only
 };
 
+const int kMaxDrawLayers = 4;   // maximum number of cached drawing layers
+const int kMaxMarkerRadius = 63;// largest marker with a cached sprite
+
 enum EDevice {
     kDeviceUnknown,
     kDevicePrinter,
@@ -100,12 +103,35 @@ public:
     virtual void    DrawArc(int cx,int cy,int rx,int ry,float ang1,float ang2) { }
     virtual void    FillArc(int cx,int cy,int rx,int ry,float ang1,float ang2) { }
     
+    // batched primitives (all in the current colour)
+    virtual void    FillRectangles(XRectangle *rects, int num)
+                    {
+                        for (int i=0; i<num; ++i) {
+                            FillRectangle(rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+                        }
+                    }
+    virtual void    FillArcs(XArc *arcs, int num)
+                    {
+                        for (int i=0; i<num; ++i) {
+                            int rx = (arcs[i].width - 1) / 2;
+                            int ry = (arcs[i].height - 1) / 2;
+                            FillArc(arcs[i].x + rx, arcs[i].y + ry, rx, ry,
+                                    arcs[i].angle1 / 64.0, arcs[i].angle2 / 64.0);
+                        }
+                    }
+    virtual void    FillMarkers(XPoint *points, int num, int size, int circles);
+    
     virtual void    PutImage(XImage *image, int dest_x, int dest_y) { }
     virtual XImage* GetImage(int x, int y, int width, int height) { return NULL; }
     virtual int     CopyArea(int x,int y,int w,int h,Window dest) { return 0; }
     virtual int     HasPixmap()         { return 0; }
+    // cache the image drawn so far as layer n, or restore it (return 0 if not possible)
+    virtual int     SaveLayer(int n)    { return 0; }
+    virtual int     RestoreLayer(int n) { return 0; }
 
     virtual EDevice GetDeviceType()     { return kDeviceUnknown; }      
+    
+    static void     GetMarkerSprite(unsigned char *buff, int radius, int stride, int aa);
         
 protected:  
     Pixel         * mColours;
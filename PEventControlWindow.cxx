@@ -21,6 +21,8 @@
 #include "PResourceManager.h"
 #include "PSpeaker.h"
 #include "PUtils.h"
+#include "PEventHistory.h"
+#include "PEventPreparer.h"
 #include "menu.h"
 
 #define WINDOW_WIDTH        350
@@ -28,6 +30,14 @@
 #define WINDOW_MIN_HEIGHT   109
 
 
+// the event filter belongs to the base main window, which receives the live
+// events (the other displays show the same events, so they share its filter)
+static ImageData *filterData(ImageData *data)
+{
+    if (PWindow::sMainWindow) return(PWindow::sMainWindow->GetData());
+    return(data);
+}
+
 //-----------------------------------------------------------------------------
 // callbacks
 //
@@ -159,6 +169,12 @@ PEventControlWindow::PEventControlWindow(ImageData *data)
     but = XtCreateManagedWidget("-1",xmPushButtonWidgetClass,w,wargs,n);
     XtAddCallback(but,XmNactivateCallback,(XtCallbackProc)backProc,data);
 
+    n = 0;
+    XtSetArg(wargs[n], XmNx, 16); ++n;
+    XtSetArg(wargs[n], XmNy, 118); ++n;
+    XtSetArg(wargs[n], XmNalignment, XmALIGNMENT_BEGINNING); ++n;
+    history_label = XtCreateManagedWidget("history_text",xmLabelWidgetClass,w,wargs,n);
+
     n = 0;
     XtSetArg(wargs[n], XmNx, 171); ++n;
     XtSetArg(wargs[n], XmNy, 114); ++n;
@@ -194,7 +210,6 @@ PEventControlWindow::PEventControlWindow(ImageData *data)
     XtSetArg(wargs[n], XmNmarginHeight, 2); ++n;
     thresh_text = XtCreateManagedWidget("Threshold",xmTextWidgetClass,w,wargs,n);
     XtAddCallback(thresh_text,XmNactivateCallback,(XtCallbackProc)filterProc,data);
-    //SetNhitText();
 
     n = 0;
     XtSetArg(wargs[n], XmNx, 16); ++n;
@@ -210,10 +225,21 @@ PEventControlWindow::PEventControlWindow(ImageData *data)
     XtSetArg(wargs[n], XmNmarginHeight, 2); ++n;
     trigger_text = XtCreateManagedWidget("Triggers",xmTextWidgetClass,w,wargs,n);
     XtAddCallback(trigger_text,XmNactivateCallback,(XtCallbackProc)filterProc,data);
-    //SetTriggerMaskText();
+
+    // the filter may only be changed from the base display (we just show it here)
+    ImageData *fdata = filterData(data);
+    if (fdata != data) {
+        strcpy(data->filter_expr, fdata->filter_expr);
+        data->trigger_mask = fdata->trigger_mask;
+        XtSetSensitive(thresh_text, FALSE);
+        XtSetSensitive(trigger_text, FALSE);
+    }
+    SetNhitText();
+    SetTriggerMaskText();
 
     UpdateEventNumber();
     UpdateTriggerText();
+    UpdateHistoryLabel(data->mHistory ? data->mHistory->GetNumBack() : 0);
 }
 
 void PEventControlWindow::CreateTriggerRadio(int num)
@@ -277,6 +303,14 @@ void PEventControlWindow::Listen(int message, void *dataPt)
 
             UpdateTriggerText();    // update the text according to the new trigger setting
         }   break;
+
+        case kMessageNewEvent: {
+            // update the filter counts
+            PEventPreparer *prep = filterData(GetData())->mPreparer;
+            if (prep && prep->IsFiltered()) {
+                UpdateTriggerText();
+            }
+        }   break;
     }
 }
 
@@ -301,17 +335,84 @@ void PEventControlWindow::UpdateTriggerText()
     } else {
         len = sprintf(buff,"<stopped>");
     }
+    PEventPreparer *prep = filterData(data)->mPreparer;
+    if (prep && prep->IsFiltered()) {
+        sprintf(buff+len,"  (%ld of %ld passed)", prep->GetNumAccepted(),
+                prep->GetNumAccepted() + prep->GetNumRejected());
+    }
     setLabelString(trigger_label, buff);
     XtResizeWidget(trigger_label, 500, 20, 0);
 }
 
 /* set trigger logic variables from strings in text widgets */
+/* - the filter is taken from the base display and shown in all displays */
 void PEventControlWindow::SetEventFilter(ImageData *data)
 {
-    PEventControlWindow *pe_win = (PEventControlWindow *)data->mWindow[EVT_NUM_WINDOW];
+    PEventControlWindow *pe_win;
+    PEventFilter        filter;
+    char                errmsg[256];
+    char                *str, *pt;
     
+    data = filterData(data);
+    pe_win = (PEventControlWindow *)data->mWindow[EVT_NUM_WINDOW];
     if (pe_win) {
+        str = XmTextGetString(pe_win->thresh_text);
+        if (filter.Parse(str, errmsg)) {
+            strncpy(data->filter_expr, str, FORMAT_LEN-1);
+            data->filter_expr[FORMAT_LEN-1] = '\0';
+        } else {
+            Printf("Bad event filter \"%s\": %s\n", str, errmsg);
+            filter.Parse(data->filter_expr);    // keep the old filter
+            pe_win->SetNhitText();
+        }
+        XtFree(str);
+        
+        str = XmTextGetString(pe_win->trigger_text);
+        unsigned long mask = strtoul(str, &pt, 0);
+        while (isspace(*pt)) ++pt;
+        if (*pt) {
+            Printf("Bad trigger mask \"%s\"\n", str);
+            pe_win->SetTriggerMaskText();
+        } else {
+            data->trigger_mask = (unsigned)mask;
+        }
+        XtFree(str);
+    } else {
+        filter.Parse(data->filter_expr);
+    }
+    filter.SetTriggerMask(data->trigger_mask);
+    if (data->mPreparer) {
+        data->mPreparer->SetFilter(&filter);
+    }
+    // show the new filter in the other displays
+    for (PWindow *win=PWindow::sMainWindow; win; win=win->mNextMainWindow) {
+        ImageData *wdata = win->GetData();
+        if (wdata == data) continue;
+        strcpy(wdata->filter_expr, data->filter_expr);
+        wdata->trigger_mask = data->trigger_mask;
+        pe_win = (PEventControlWindow *)wdata->mWindow[EVT_NUM_WINDOW];
+        if (pe_win) {
+            pe_win->SetNhitText();
+            pe_win->SetTriggerMaskText();
+        }
+    }
+}
+
+void PEventControlWindow::SetNhitText()
+{
+    setTextString(thresh_text, GetData()->filter_expr);
+}
+
+void PEventControlWindow::SetTriggerMaskText()
+{
+    char    buff[64];
+    
+    if (GetData()->trigger_mask) {
+        sprintf(buff, "0x%x", GetData()->trigger_mask);
+    } else {
+        buff[0] = '\0';
     }
+    setTextString(trigger_text, buff);
 }
 
 void PEventControlWindow::Show()
@@ -336,3 +437,26 @@ void PEventControlWindow::UpdateEventNumber()
 {
 }
 
+/* Show whether we are looking at an event from the history */
+void PEventControlWindow::UpdateHistoryLabel(ImageData *data)
+{
+    PEventControlWindow *pe_win = (PEventControlWindow *)data->mWindow[EVT_NUM_WINDOW];
+    if (pe_win) {
+        pe_win->UpdateHistoryLabel(data->mHistory ? data->mHistory->GetNumBack() : 0);
+    }
+}
+
+// isHistory - number of events back from the most recent (0 if not in history)
+void PEventControlWindow::UpdateHistoryLabel(int isHistory)
+{
+    char        buff[64];
+    
+    if (isHistory) {
+        sprintf(buff, "History (-%d)", isHistory);
+    } else {
+        buff[0] = '\0';
+    }
+    setLabelString(history_label, buff);
+    XtResizeWidget(history_label, 110, 20, 0);
+}
+
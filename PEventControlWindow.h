@@ -33,6 +33,7 @@ public:
     
     static void     UpdateTriggerText(ImageData *data);
     static void     UpdateEventNumber(ImageData *data);
+    static void     UpdateHistoryLabel(ImageData *data);
     static void     SetEventFilter(ImageData *data);
 
     static void     GotoProc(Widget w,PEventControlWindow *pe_win, caddr_t call_data);
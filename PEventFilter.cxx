@@ -0,0 +1,295 @@
+//==============================================================================
+// File:        PEventFilter.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "PEventFilter.h"
+#include "PEventSource.h"
+
+enum EFilterOp {
+    kOpConst,
+    kOpVar,
+    kOpLT,
+    kOpLE,
+    kOpGT,
+    kOpGE,
+    kOpEQ,
+    kOpNE,
+    kOpBitAnd,
+    kOpNot,
+    kOpAnd,
+    kOpOr
+};
+
+enum EFilterVar {
+    kVarNhit,
+    kVarPoints,
+    kVarTracks,
+    kVarHelices,
+    kVarLines,
+    kVarVertex,
+    kVarVX,
+    kVarVY,
+    kVarVZ,
+    kVarVR,
+    kVarTrig,
+    kNumFilterVars
+};
+
+static const char *sVarName[kNumFilterVars] = {
+    "nhit", "points", "tracks", "helices", "lines", "vertex",
+    "vx", "vy", "vz", "vr", "trig"
+};
+
+PEventFilter::PEventFilter()
+{
+    Clear();
+}
+
+void PEventFilter::Clear()
+{
+    mNumOps = 0;
+    mTriggerMask = 0;
+    mPt = NULL;
+    mErr = NULL;
+}
+
+// Parse - compile a filter expression
+// - an empty expression accepts all events
+// - returns zero on error, and copies the error message to errmsg if given
+// - the trigger mask is not changed
+int PEventFilter::Parse(const char *expr, char *errmsg)
+{
+    mNumOps = 0;
+    mErr = NULL;
+    mPt = expr ? expr : "";
+    SkipSpace();
+    if (*mPt) {
+        ParseOr();
+        SkipSpace();
+        if (!mErr && *mPt) mErr = "Unexpected characters";
+    }
+    if (!mErr && mNumOps == 1 && mOp[0].code == kOpConst) {
+        // a plain number is an NHIT threshold
+        double thresh = mOp[0].val;
+        mNumOps = 0;
+        Add(kOpVar, kVarNhit);
+        Add(kOpConst, thresh);
+        Add(kOpGE);
+    }
+    mPt = NULL;
+    if (mErr) {
+        if (errmsg) strcpy(errmsg, mErr);
+        mNumOps = 0;
+        mErr = NULL;
+        return(0);
+    }
+    return(1);
+}
+
+// Accept - return non-zero if the event passes the filter
+int PEventFilter::Accept(PEventSource *source)
+{
+    double      stack[kMaxFilterOps];
+    int         n = 0;
+
+    if (mTriggerMask) {
+        unsigned bits;
+        if (source->GetTriggerBits(&bits) && !(bits & mTriggerMask)) return(0);
+    }
+    for (int i=0; i<mNumOps; ++i) {
+        Op *op = mOp + i;
+        switch (op->code) {
+            case kOpConst:
+                stack[n++] = op->val;
+                continue;
+            case kOpVar:
+                stack[n++] = GetVar(source, (int)op->val);
+                continue;
+            case kOpNot:
+                stack[n-1] = !stack[n-1];
+                continue;
+        }
+        // binary operation
+        double b = stack[--n];
+        double a = stack[n-1];
+        double r;
+        switch (op->code) {
+            case kOpLT:     r = (a <  b);   break;
+            case kOpLE:     r = (a <= b);   break;
+            case kOpGT:     r = (a >  b);   break;
+            case kOpGE:     r = (a >= b);   break;
+            case kOpEQ:     r = (a == b);   break;
+            case kOpNE:     r = (a != b);   break;
+            case kOpBitAnd: r = (double)((unsigned long)a & (unsigned long)b); break;
+            case kOpAnd:    r = (a && b);   break;
+            case kOpOr:     r = (a || b);   break;
+            default:        r = 0;          break;
+        }
+        stack[n-1] = r;
+    }
+    return(n ? stack[n-1] != 0 : 1);
+}
+
+// get the value of a filter variable for this event
+double PEventFilter::GetVar(PEventSource *source, int var)
+{
+    double      xyz[3];
+    unsigned    bits;
+
+    switch (var) {
+        case kVarNhit:
+            return(source->GetNumHits());
+        case kVarPoints:
+            return(source->GetNumSpacePoints());
+        case kVarTracks:
+            return(source->GetNumTracks());
+        case kVarHelices:
+            return(source->GetNumHelices());
+        case kVarLines:
+            return(source->GetNumLines());
+        case kVarVertex:
+            return(source->GetVertex(xyz) != 0);
+        case kVarVX:
+        case kVarVY:
+        case kVarVZ:
+        case kVarVR:
+            // (events with no vertex are far outside the detector)
+            if (!source->GetVertex(xyz)) return(1e9);
+            if (var == kVarVR) return(sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1]));
+            return(xyz[var - kVarVX]);
+        case kVarTrig:
+            return(source->GetTriggerBits(&bits) ? bits : 0);
+    }
+    return(0);
+}
+
+// add an operation to the program
+int PEventFilter::Add(int code, double val)
+{
+    if (mNumOps >= kMaxFilterOps) {
+        if (!mErr) mErr = "Filter too complex";
+        return(0);
+    }
+    mOp[mNumOps].code = code;
+    mOp[mNumOps].val = val;
+    ++mNumOps;
+    return(1);
+}
+
+void PEventFilter::SkipSpace()
+{
+    while (isspace(*mPt)) ++mPt;
+}
+
+// expr || expr
+int PEventFilter::ParseOr()
+{
+    if (!ParseAnd()) return(0);
+    for (;;) {
+        SkipSpace();
+        if (mPt[0] != '|' || mPt[1] != '|') return(1);
+        mPt += 2;
+        if (!ParseAnd() || !Add(kOpOr)) return(0);
+    }
+}
+
+// expr && expr
+int PEventFilter::ParseAnd()
+{
+    if (!ParseUnary()) return(0);
+    for (;;) {
+        SkipSpace();
+        if (mPt[0] != '&' || mPt[1] != '&') return(1);
+        mPt += 2;
+        if (!ParseUnary() || !Add(kOpAnd)) return(0);
+    }
+}
+
+// !expr
+int PEventFilter::ParseUnary()
+{
+    SkipSpace();
+    if (*mPt == '!' && mPt[1] != '=') {
+        ++mPt;
+        return(ParseUnary() && Add(kOpNot));
+    }
+    return(ParseCompare());
+}
+
+// value [& value...] [op value [& value...]]
+int PEventFilter::ParseCompare()
+{
+    int     code = kOpEQ;
+
+    for (int side=0; side<2; ++side) {
+        if (!ParseValue()) return(0);
+        for (;;) {
+            SkipSpace();
+            if (mPt[0] != '&' || mPt[1] == '&') break;
+            ++mPt;
+            if (!ParseValue() || !Add(kOpBitAnd)) return(0);
+        }
+        if (side) return(Add(code));
+        if      (!strncmp(mPt, "<=", 2)) code = kOpLE;
+        else if (!strncmp(mPt, ">=", 2)) code = kOpGE;
+        else if (!strncmp(mPt, "==", 2)) code = kOpEQ;
+        else if (!strncmp(mPt, "!=", 2)) code = kOpNE;
+        else if (*mPt == '<') code = kOpLT;
+        else if (*mPt == '>') code = kOpGT;
+        else if (*mPt == '=') code = kOpEQ;
+        else return(1);
+        mPt += (code == kOpLT || code == kOpGT || (code == kOpEQ && mPt[1] != '=')) ? 1 : 2;
+    }
+    return(1);
+}
+
+// number, variable or (expr)
+int PEventFilter::ParseValue()
+{
+    SkipSpace();
+    if (*mPt == '(') {
+        ++mPt;
+        if (!ParseOr()) return(0);
+        SkipSpace();
+        if (*mPt != ')') {
+            mErr = "Missing ')'";
+            return(0);
+        }
+        ++mPt;
+        return(1);
+    }
+    if (isdigit(*mPt) || *mPt == '-' || *mPt == '.') {
+        char *end;
+        double val;
+        if (mPt[0] == '0' && (mPt[1] == 'x' || mPt[1] == 'X')) {
+            val = strtoul(mPt, &end, 16);
+        } else {
+            val = strtod(mPt, &end);
+        }
+        if (end == mPt) {
+            mErr = "Bad number";
+            return(0);
+        }
+        mPt = end;
+        return(Add(kOpConst, val));
+    }
+    if (isalpha(*mPt)) {
+        const char *start = mPt;
+        while (isalnum(*mPt)) ++mPt;
+        int len = mPt - start;
+        for (int i=0; i<kNumFilterVars; ++i) {
+            if ((int)strlen(sVarName[i]) == len && !strncasecmp(start, sVarName[i], len)) {
+                return(Add(kOpVar, i));
+            }
+        }
+        mErr = "Unknown variable";
+        return(0);
+    }
+    mErr = *mPt ? "Syntax error" : "Unexpected end of expression";
+    return(0);
+}
@@ -0,0 +1,67 @@
+//==============================================================================
+// File:        PEventFilter.h
+//
+// Description: Event filter applied before events are prepared for display
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PEventFilter_h__
+#define __PEventFilter_h__
+
+class PEventSource;
+
+const int kMaxFilterOps = 64;           // maximum number of operations in a filter
+
+/*
+** PEventFilter - parsed predicate on the raw event
+**
+** The expression is compiled to a short postfix program which is evaluated
+** against the PEventSource, so rejected events cost only a few calls to the
+** source.  Variables are:
+**
+**      nhit     - number of hits         points  - number of space points
+**      tracks   - number of tracks       helices - number of helix fits
+**      lines    - number of line fits    vertex  - 1 if there is a vertex
+**      vx,vy,vz - vertex position (mm)   vr      - vertex radius (mm)
+**      trig     - trigger bits
+**
+** combined with comparisons (< <= > >= == !=), '&' (bitwise and), '!', '&&',
+** '||' and parentheses.  A plain number is taken as an NHIT threshold, eg.
+** "50" is the same as "nhit>=50".  If a trigger mask is set, the event must
+** have one of the masked trigger bits (unless its source has no trigger bits).
+**
+** The filter is a plain object so it may be copied between threads.
+*/
+class PEventFilter {
+public:
+    PEventFilter();
+
+    int             Parse(const char *expr, char *errmsg=(char *)0);
+    void            SetTriggerMask(unsigned mask)   { mTriggerMask = mask; }
+    void            Clear();
+    int             IsEmpty()           { return !mNumOps && !mTriggerMask; }
+    int             Accept(PEventSource *source);
+
+private:
+    struct Op {
+        int         code;               // operation code
+        double      val;                // constant value or variable number
+    };
+
+    int             ParseOr();
+    int             ParseAnd();
+    int             ParseUnary();
+    int             ParseCompare();
+    int             ParseValue();
+    int             Add(int code, double val=0);
+    void            SkipSpace();
+    double          GetVar(PEventSource *source, int var);
+
+    Op              mOp[kMaxFilterOps]; // compiled program (postfix)
+    int             mNumOps;            // number of operations in program
+    unsigned        mTriggerMask;       // trigger bits to accept (0 = any)
+    const char    * mPt;                // current parse position
+    const char    * mErr;               // parse error message (NULL if none)
+};
+
+#endif // __PEventFilter_h__
@@ -0,0 +1,243 @@
+//==============================================================================
+// File:        PEventGenerator.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <math.h>
+#include "PEventGenerator.h"
+#include "ImageData.h"
+
+// drift volume (mm), from the dimensions in detector.geo
+const double kGenRN         = 109.2;                // detector.geo RN
+const double kGenInnerR     = 0.203455 * kGenRN;    // inner wall radius
+const double kGenOuterR     = kGenRN;               // outer radius
+const double kGenHalfZ      = 1.318078 * kGenRN;    // half length
+
+const double kGenDriftTime  = 4000;     // maximum drift time (ns)
+const double kGenSampleTime = 16;       // waveform sampling period (ns)
+const int    kGenPreTrigger = 100;      // waveform samples before trigger
+const int    kGenWireSamples = 411;     // number of samples in wire waveform
+const int    kGenPadSamples = 511;      // number of samples in pad waveform
+const int    kGenNumSectors = 32;       // number of pad sectors in phi
+const int    kGenNumRows    = NUM_AG_PADS / kGenNumSectors;    // pad rows in z
+
+PEventGenerator::PEventGenerator(int numHits, unsigned long seed)
+{
+    mNumHits = numHits;
+    mHitsPerTrack = 40;
+    mNoise = 0.1;
+    mWaveforms = 1;
+    mEventID = 0;
+    mTrigger = 0;
+    mVertex[0] = mVertex[1] = mVertex[2] = 0;
+    mState = seed ? seed : 1;
+    mWireHit.assign(NUM_AG_WIRES, 0);
+    mPadHit.assign(NUM_AG_PADS, 0);
+}
+
+// Next - generate the next event
+void PEventGenerator::Next()
+{
+    ++mEventID;
+    mTrigger = 1u << (int)(Random() * 4);   // one of 4 trigger types
+    mPoints.clear();
+    mHelices.clear();
+
+    // annihilation vertex on the inner wall
+    double a = Random() * 2 * PI;
+    mVertex[0] = kGenInnerR * cos(a);
+    mVertex[1] = kGenInnerR * sin(a);
+    mVertex[2] = (Random() - 0.5) * kGenHalfZ;
+
+    int numNoise = (int)(mNumHits * mNoise);
+    int numTrack = mNumHits - numNoise;
+    int tries = 0;
+    while (numTrack > 0 && tries < 100) {
+        int n = numTrack < mHitsPerTrack ? numTrack : mHitsPerTrack;
+        if (AddTrack(n)) {
+            numTrack -= n;
+            tries = 0;
+        } else {
+            ++tries;
+        }
+    }
+    // make up any shortfall with noise
+    numNoise = mNumHits - (int)mPoints.size();
+    for (int i=0; i<numNoise; ++i) {
+        // uniform in the drift volume
+        double r = sqrt(kGenInnerR * kGenInnerR +
+                   Random() * (kGenOuterR * kGenOuterR - kGenInnerR * kGenInnerR));
+        double phi = Random() * 2 * PI;
+        AddPoint(r * cos(phi), r * sin(phi), (2 * Random() - 1) * kGenHalfZ);
+    }
+    AddWaveforms();
+}
+
+int PEventGenerator::GetVertex(double *xyz)
+{
+    xyz[0] = mVertex[0];
+    xyz[1] = mVertex[1];
+    xyz[2] = mVertex[2];
+    return(1);
+}
+
+int PEventGenerator::GetWaveformLength(int type, int n)
+{
+    return(type == kWireWaveform ? kGenWireSamples : kGenPadSamples);
+}
+
+// generate the samples for a waveform
+// - noisy baseline with a negative pulse at the drift time
+void PEventGenerator::GetWaveform(int type, int n, int *samples)
+{
+    Wave *wave = &mWave[type][n];
+    int num = GetWaveformLength(type, n);
+    double t0 = kGenPreTrigger + wave->time / kGenSampleTime;
+    double rise = type == kWireWaveform ? 2 : 8;
+    double fall = type == kWireWaveform ? 10 : 40;
+    unsigned long long state = mState;
+    mState = wave->seed;
+    for (int i=0; i<num; ++i) {
+        double v = 5 * Gauss();
+        double dt = i - t0;
+        if (dt > 0) v -= wave->height * (1 - exp(-dt / rise)) * exp(-dt / fall);
+        samples[i] = (int)floor(v + 0.5);
+    }
+    mState = state;
+}
+
+// add a helical track from the vertex with the specified number of space points
+// - returns zero if the track doesn't cross the drift volume
+int PEventGenerator::AddTrack(int num)
+{
+    SourceHelix helix;
+    double      x, y, z, t;
+
+    // random momentum direction and radius of curvature
+    double psi = Random() * 2 * PI;
+    double r = kGenOuterR * (0.5 + 10 * Random());
+    if (Random() < 0.5) r = -r;
+    double s = r < 0 ? -1 : 1;
+    double lambda = tan((2 * Random() - 1) * PI / 3);
+
+    // helix parameters referenced to the point of closest approach to the z axis
+    double xc = mVertex[0] - r * sin(psi);
+    double yc = mVertex[1] + r * cos(psi);
+    double rc = sqrt(xc * xc + yc * yc);
+    helix.c = 1 / (2 * r);
+    helix.phi0 = atan2(-s * xc, s * yc);
+    helix.d = s * rc - r;
+    helix.lambda = lambda;
+    helix.dir = (int)s;
+    helix.status = 1;
+    helix.x0 = -helix.d * sin(helix.phi0);
+    helix.y0 =  helix.d * cos(helix.phi0);
+    double tv = remainder(psi - helix.phi0, 2 * PI);   // turning angle at vertex
+    helix.z0 = mVertex[2] - r * lambda * tv;
+
+    // step along the track to find where it is in the drift volume
+    double step = s * 1.0 / fabs(r);    // (1 mm steps)
+    double t1 = 0, t2 = 0;
+    int inside = 0;
+    for (t=tv; fabs(t-tv)<2*PI; t+=step) {
+        x = xc + r * sin(helix.phi0 + t);
+        y = yc - r * cos(helix.phi0 + t);
+        z = helix.z0 + r * lambda * t;
+        double rho = sqrt(x * x + y * y);
+        if (rho >= kGenInnerR && rho <= kGenOuterR && fabs(z) <= kGenHalfZ) {
+            if (!inside) t1 = t;
+            t2 = t;
+            inside = 1;
+        } else if (inside || rho > kGenOuterR || fabs(z) > kGenHalfZ) {
+            break;
+        }
+    }
+    if (!inside || t1 == t2) return(0);
+
+    for (int i=0; i<num; ++i) {
+        t = t1 + (t2 - t1) * (i + Random()) / num;
+        AddPoint(xc + r * sin(helix.phi0 + t),
+                 yc - r * cos(helix.phi0 + t),
+                 helix.z0 + r * lambda * t);
+    }
+    mHelices.push_back(helix);
+    return(1);
+}
+
+// add a space point with resolution smearing, and find its wire and pad
+void PEventGenerator::AddPoint(double x, double y, double z)
+{
+    SourcePoint sp;
+
+    sp.err[0] = sp.err[1] = 1 + Random();
+    sp.err[2] = 2 + 2 * Random();
+    sp.x = x + sp.err[0] * Gauss();
+    sp.y = y + sp.err[1] * Gauss();
+    sp.z = z + sp.err[2] * Gauss();
+
+    double rho = sqrt(x * x + y * y);
+    double phi = atan2(y, x);
+    if (phi < 0) phi += 2 * PI;
+    sp.time = (kGenOuterR - rho) / (kGenOuterR - kGenInnerR) * kGenDriftTime;
+    sp.height = 500 + 2000 * -log(1 - Random());
+    if (sp.height > 30000) sp.height = 30000;
+    sp.wire = (int)(phi / (2 * PI) * NUM_AG_WIRES) % NUM_AG_WIRES;
+    int sec = (int)(phi / (2 * PI) * kGenNumSectors) % kGenNumSectors;
+    int row = (int)((z + kGenHalfZ) / (2 * kGenHalfZ) * kGenNumRows);
+    if (row < 0) row = 0;
+    if (row >= kGenNumRows) row = kGenNumRows - 1;
+    sp.pad = sec + row * kGenNumSectors;
+    mPoints.push_back(sp);
+}
+
+// add a waveform for each hit wire and pad
+// - the samples are generated on demand from the stored pulse parameters
+void PEventGenerator::AddWaveforms()
+{
+    Wave wave;
+
+    mWave[kWireWaveform].clear();
+    mWave[kPadWaveform].clear();
+    if (!mWaveforms) return;
+
+    char *wireHit = &mWireHit[0];
+    char *padHit = &mPadHit[0];
+
+    for (size_t i=0; i<mPoints.size(); ++i) {
+        SourcePoint *sp = &mPoints[i];
+        wave.time = sp->time;
+        wave.height = sp->height;
+        if (!wireHit[sp->wire]) {
+            wireHit[sp->wire] = 1;
+            wave.chan = sp->wire;
+            wave.seed = (unsigned long long)(Random() * 4294967295.0) + 1;
+            mWave[kWireWaveform].push_back(wave);
+        }
+        if (!padHit[sp->pad]) {
+            padHit[sp->pad] = 1;
+            wave.chan = sp->pad;
+            wave.seed = (unsigned long long)(Random() * 4294967295.0) + 1;
+            mWave[kPadWaveform].push_back(wave);
+        }
+    }
+    // reset our flags for next time
+    for (size_t i=0; i<mWave[kWireWaveform].size(); ++i) wireHit[mWave[kWireWaveform][i].chan] = 0;
+    for (size_t i=0; i<mWave[kPadWaveform].size(); ++i) padHit[mWave[kPadWaveform][i].chan] = 0;
+}
+
+// uniform random number in the range [0,1) (xorshift64*)
+double PEventGenerator::Random()
+{
+    unsigned long long x = mState;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    mState = x;
+    return((double)((x * 2685821657736338717ULL) >> 11) / 9007199254740992.0);
+}
+
+// gaussian random number with unit standard deviation
+double PEventGenerator::Gauss()
+{
+    return(sqrt(-2 * log(1 - Random())) * cos(2 * PI * Random()));
+}
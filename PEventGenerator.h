@@ -0,0 +1,89 @@
+//==============================================================================
+// File:        PEventGenerator.h
+//
+// Description: Synthetic event source for testing and profiling the display
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PEventGenerator_h__
+#define __PEventGenerator_h__
+
+#include <vector>
+#include "PEventSource.h"
+
+/*
+** PEventGenerator - generates random events without ROOT
+**
+** Each event has helical tracks from a common vertex on the inner wall,
+** plus uniformly distributed noise hits, all within the drift volume of
+** detector.geo.  A waveform is generated for each hit wire and pad.  The
+** number of space points per event is configurable, so the display may be
+** profiled at any multiplicity:
+**
+**      PEventGenerator gen(10000);
+**      for (;;) { gen.Next(); aged->ShowEvent(&gen, 0); }
+*/
+class PEventGenerator : public PEventSource {
+public:
+    PEventGenerator(int numHits=100, unsigned long seed=1);
+
+    void            Next();             // generate the next event
+
+    void            SetNumHits(int num)             { mNumHits = num > 0 ? num : 0; }
+    void            SetHitsPerTrack(int num)        { mHitsPerTrack = num > 1 ? num : 2; }
+    void            SetNoiseFraction(double f)      { mNoise = f; }
+    void            SetWaveforms(int on)            { mWaveforms = on; }
+
+    virtual long    GetEventID()                    { return mEventID; }
+    virtual long    GetNumHits()                    { return mPoints.size(); }
+    virtual long    GetNumTracks()                  { return mHelices.size(); }
+    virtual int     GetTriggerBits(unsigned *bits)  { *bits = mTrigger; return 1; }
+
+    virtual int     GetNumSpacePoints()             { return mPoints.size(); }
+    virtual void    GetSpacePoint(int n, SourcePoint *sp) { *sp = mPoints[n]; }
+
+    virtual int     GetNumLines()                   { return 0; }
+    virtual void    GetLine(int n, SourceLine *line) { }
+
+    virtual int     GetNumHelices()                 { return mHelices.size(); }
+    virtual void    GetHelix(int n, SourceHelix *helix) { *helix = mHelices[n]; }
+
+    virtual int     GetVertex(double *xyz);
+
+    virtual int     GetNumWaveforms(int type)       { return mWave[type].size(); }
+    virtual int     GetWaveformChannel(int type, int n) { return mWave[type][n].chan; }
+    virtual int     GetWaveformLength(int type, int n);
+    virtual void    GetWaveform(int type, int n, int *samples);
+
+private:
+    struct Wave {
+        int         chan;               // wire number or pad index
+        double      time;               // pulse time (ns)
+        double      height;             // pulse height
+        unsigned long long seed;        // seed for baseline noise
+    };
+
+    int             AddTrack(int num);
+    void            AddPoint(double x, double y, double z);
+    void            AddWaveforms();
+    double          Random();
+    double          Gauss();
+
+    int             mNumHits;           // number of space points per event
+    int             mHitsPerTrack;      // number of space points per track
+    double          mNoise;             // fraction of space points that are noise
+    int             mWaveforms;         // flag to generate waveforms
+
+    long            mEventID;           // current event number
+    unsigned        mTrigger;           // trigger bits for current event
+    double          mVertex[3];         // event vertex (mm)
+    unsigned long long mState;          // random number generator state
+
+    std::vector<SourcePoint> mPoints;   // generated space points
+    std::vector<SourceHelix> mHelices;  // generated tracks
+    std::vector<Wave> mWave[kNumWaveformTypes];  // waveforms for hit channels
+    std::vector<char> mWireHit;         // flags for hit wires (all zero between events)
+    std::vector<char> mPadHit;          // flags for hit pads (all zero between events)
+};
+
+#endif // __PEventGenerator_h__
@@ -88,7 +88,7 @@ void PEventHistogram::MakeHistogram()
     ImageData   *data = mOwner->GetData();
     int         i,n,num,slab;
     long        max;
-    HitInfo     *hi  = data->hits.hit_info;
+    short       *flags = data->hits.hit_flags;
     long        bit_mask;
     long        nbin = data->hist_bins;
     float       val, first, last, range;
@@ -107,15 +107,12 @@ void PEventHistogram::MakeHistogram()
 ** Calculate and draw histogram
 */
     if (mHistogram && nbin!=mNumBins) {
-        delete [] mHistogram;
         ClearOverlays();
-        mHistogram = NULL;
     }
-    if (!mHistogram || !mOverlay[0]) {
-        if (mHistogram) delete [] mHistogram;
+    if (!mHistogram || !mOverlay[0] || nbin!=mNumBins) {
         if (mOverlay[0]) delete [] mOverlay[0];
         // allocate histogram and overlay arrays
-        mHistogram = new long[nbin];
+        CreateData(nbin);
         mOverlay[0] = new long[nbin];
         if (!mHistogram || !mOverlay[0]) {
             Printf("Out of memory for histogram\n");
@@ -135,30 +132,30 @@ void PEventHistogram::MakeHistogram()
     // because we may be in the process of changing the scale
     bit_mask = data->bit_mask & ~(HIT_UNDERSCALE | HIT_OVERSCALE);
     
-    for (i=0; i<num; ++i, ++hi) {
+    for (i=0; i<num; ++i) {
     
-        if (hi->flags & bit_mask) continue; /* only consider unmasked hits */
+        if (flags[i] & bit_mask) continue; /* only consider unmasked hits */
 
         /* calculate bin number  */
-        val = (getHitValPad(data, hi) - first) * nbin / range;
+        val = (getHitValPad(data, i) - first) * nbin / range;
  
         // convert val to an integral bin number
         if (isnan(val) || val < 0) {
             // ignore underscale hits if masked out
             if (data->bit_mask & HIT_UNDERSCALE) continue;
             n = 0;
-            if (!(hi->flags & HIT_DISCARDED)) mUnderscale += incr;
+            if (!(flags[i] & HIT_DISCARDED)) mUnderscale += incr;
         } else if (val >= nbin) {
             // ignore overscale hits if masked out
             if (data->bit_mask & HIT_OVERSCALE) continue;
             n = nbin - 1;
-            if (!(hi->flags & HIT_DISCARDED)) mOverscale += incr;
+            if (!(flags[i] & HIT_DISCARDED)) mOverscale += incr;
         } else {
             n = (int)val;
         }
         if ((mHistogram[n] += incr) > max) max = mHistogram[n];
         // keep track of discarded hits in each bin
-        if (hi->flags & HIT_DISCARDED) mOverlay[0][n] += incr;
+        if (flags[i] & HIT_DISCARDED) mOverlay[0][n] += incr;
     }
     /* calculate a nice even maximum value for the y axis */
     if (!(mGrabFlag & GRAB_Y)) {
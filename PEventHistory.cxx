@@ -0,0 +1,89 @@
+//==============================================================================
+// File:        PEventHistory.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <string.h>
+#include "PEventHistory.h"
+#include "AgedEvent.h"
+#include "PArena.h"
+#include "CUtils.h"
+
+PEventHistory::PEventHistory(int maxEvents, int maxMB)
+{
+    if (maxEvents < 1) maxEvents = 1;
+    if (maxMB < 1) maxMB = 1;
+    mMaxEvents  = maxEvents;
+    mMaxBytes   = (size_t)maxMB * 1024 * 1024;
+    mNum        = 0;
+    mCur        = 0;
+    mBytes      = 0;
+    mClock      = 0;
+    // (one extra entry so we can add before evicting)
+    mEntry = new Entry[maxEvents + 1];
+    if (!mEntry) {
+        Printf("Out of memory for event history\n");
+        mMaxEvents = 0;
+    }
+}
+
+PEventHistory::~PEventHistory()
+{
+    for (int i=0; i<mNum; ++i) {
+        releaseEvent(mEntry[i].ev);
+    }
+    delete [] mEntry;
+}
+
+// Add - add a newly displayed event to the history
+// - the history holds a reference to the event, and it becomes the current event
+void PEventHistory::Add(AgedEvent *ev)
+{
+    if (!mEntry) return;
+    retainEvent(ev);
+    Entry *entry = mEntry + mNum;
+    entry->ev = ev;
+    entry->bytes = sizeof(AgedEvent) + ev->arena->GetSize();
+    entry->last_used = ++mClock;
+    mBytes += entry->bytes;
+    mCur = mNum++;
+    Evict();
+}
+
+// Step - step forward (dir>0) or back (dir<0) in the history
+// - returns the new current event, or NULL if we can't step in this direction
+// - steps are limited by the ends of the history
+AgedEvent *PEventHistory::Step(int dir)
+{
+    if (!mNum) return((AgedEvent *)NULL);
+    int index = mCur + dir;
+    if (index < 0) index = 0;
+    if (index >= mNum) index = mNum - 1;
+    if (index == mCur) return((AgedEvent *)NULL);
+    mCur = index;
+    mEntry[index].last_used = ++mClock;
+    return(mEntry[index].ev);
+}
+
+// remove the specified entry and release its event
+void PEventHistory::Remove(int index)
+{
+    mBytes -= mEntry[index].bytes;
+    releaseEvent(mEntry[index].ev);
+    --mNum;
+    memmove(mEntry + index, mEntry + index + 1, (mNum - index) * sizeof(Entry));
+    if (mCur > index) --mCur;
+}
+
+// release least recently used events until we are within our limits
+void PEventHistory::Evict()
+{
+    while (mNum > 1 && (mNum > mMaxEvents || mBytes > mMaxBytes)) {
+        int lru = -1;
+        for (int i=0; i<mNum; ++i) {
+            if (i == mCur) continue;    // never release the current event
+            if (lru < 0 || mEntry[i].last_used < mEntry[lru].last_used) lru = i;
+        }
+        Remove(lru);
+    }
+}
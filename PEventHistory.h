@@ -0,0 +1,52 @@
+//==============================================================================
+// File:        PEventHistory.h
+//
+// Description: History of recently displayed events
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PEventHistory_h__
+#define __PEventHistory_h__
+
+#include <stddef.h>
+
+struct AgedEvent;
+
+/*
+** PEventHistory - holds recently displayed events so we can step back to them
+**
+** Events are kept in the order they were first displayed.  When the history
+** exceeds its maximum number of events or its memory budget, the least
+** recently displayed event is released (never the current one).
+*/
+class PEventHistory {
+public:
+    PEventHistory(int maxEvents, int maxMB);
+    ~PEventHistory();
+
+    void            Add(AgedEvent *ev);
+    AgedEvent     * Step(int dir);
+
+    int             GetNumBack()        { return mNum ? mNum - 1 - mCur : 0; }
+    int             GetNumEvents()      { return mNum; }
+    size_t          GetBytes()          { return mBytes; }
+
+private:
+    struct Entry {
+        AgedEvent * ev;                 // the event
+        size_t      bytes;              // memory held by the event (whole arena)
+        unsigned long last_used;        // time stamp of last display
+    };
+    void            Remove(int index);
+    void            Evict();
+
+    Entry         * mEntry;             // events in display order (oldest first)
+    int             mMaxEvents;         // maximum number of events
+    size_t          mMaxBytes;          // maximum memory for events
+    int             mNum;               // number of events in history
+    int             mCur;               // index of current event
+    size_t          mBytes;             // memory used by events in history
+    unsigned long   mClock;             // counter for last_used time stamps
+};
+
+#endif // __PEventHistory_h__
@@ -19,7 +19,7 @@
 #include "PEventInfoWindow.h"
 #include "PUtils.h"
 #include "PSpeaker.h"
-#include "TStoreEvent.hh"
+#include "AgedEvent.h"
 
 //---------------------------------------------------------------------------
 // PEventInfoWindow constructor
@@ -99,7 +99,7 @@ void PEventInfoWindow::UpdateSelf()
 {
     ImageData   *data = GetData();
     char        buff[256];
-    TStoreEvent *evt = data->agEvent;
+    AgedEvent   *evt = data->mEvent;
  
 #ifdef PRINT_DRAWS
     Printf("-updateEventInfo\n");
@@ -119,34 +119,34 @@ void PEventInfoWindow::UpdateSelf()
         return;
     }
 
-    sprintf(buff,data->hex_id ? "0x%.6lx" : "%ld",(long)evt->GetEventNumber());
+    sprintf(buff,data->hex_id ? "0x%.6lx" : "%ld",evt->event_id);
     tw_evt.SetStringNow(buff);
     sprintf(buff, "%ld", (long)data->run_number);
     tw_run.SetStringNow(buff);
-    sprintf(buff, "%ld", (long)evt->GetNumberOfHits());
+    sprintf(buff, "%ld", evt->num_hits);
     tw_nhit.SetStringNow(buff);
-    sprintf(buff, "%ld", (long)evt->GetNumberOfTracks());
+    sprintf(buff, "%ld", evt->num_tracks);
     tw_tracks.SetStringNow(buff);
-    sprintf(buff, "%d", evt->GetLineArray() ? evt->GetLineArray()->GetEntries() : 0);
+    sprintf(buff, "%d", evt->num_lines);
     tw_lines.SetStringNow(buff);
-    sprintf(buff, "%d", evt->GetHelixArray() ? evt->GetHelixArray()->GetEntries() : 0);
+    sprintf(buff, "%d", evt->num_helices);
     tw_helices.SetStringNow(buff);
-    if (evt->GetVertex().X() < -998) {
+    if (evt->vertex.x < -998) {
         strcpy(buff,"-");
     } else {
-        sprintf(buff, "%g", evt->GetVertex().X());
+        sprintf(buff, "%g", evt->vertex.x);
     }
     tw_vertexX.SetStringNow(buff);
-    if (evt->GetVertex().Y() < -998) {
+    if (evt->vertex.y < -998) {
         strcpy(buff,"-");
     } else {
-        sprintf(buff, "%g", evt->GetVertex().Y());
+        sprintf(buff, "%g", evt->vertex.y);
     }
     tw_vertexY.SetStringNow(buff);
-    if (evt->GetVertex().Z() < -998) {
+    if (evt->vertex.z < -998) {
         strcpy(buff,"-");
     } else {
-        sprintf(buff, "%g", evt->GetVertex().Z());
+        sprintf(buff, "%g", evt->vertex.z);
     }
     tw_vertexZ.SetStringNow(buff);
 }
@@ -0,0 +1,652 @@
+//==============================================================================
+// File:        PEventPreparer.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "PEventPreparer.h"
+#include "AgedEvent.h"
+#include "PArena.h"
+#include "PSnapshotFile.h"
+#include "CUtils.h"
+
+const double kMaxR = 175 / AG_SCALE;   // maximum radius for helix track
+const double kMaxRSq = kMaxR * kMaxR;
+const double kFitLineLength = 1.5;
+
+//---------------------------------------------------------------------------------
+// PEventPreparer constructor
+//
+PEventPreparer::PEventPreparer(ImageData *data, int depth, int policy)
+{
+    mData       = data;
+    if (depth < 1) depth = 1;
+    if (depth > kMaxPrefetch) depth = kMaxPrefetch;
+    mDepth      = depth;
+    mPolicy     = kSubmitBlock;
+    mStopped    = 0;
+    mQueueHead  = 0;
+    mQueueTail  = 0;
+    mLatest     = NULL;
+    mReturnHead = 0;
+    mReturnTail = 0;
+    mQuit       = 0;
+    mJobHead    = 0;
+    mNumJobs    = 0;
+    mNumPending = 0;
+    mFree       = NULL;
+    mNumEvents  = 0;
+    mNumSubmitted = 0;
+    mNumDisplayed = 0;
+    mNumDropped = 0;
+    mNumAccepted = 0;
+    mNumRejected = 0;
+    mFiltered   = 0;
+    mInputId    = 0;
+    memset(&mScale, 0, sizeof(mScale));
+    pthread_mutex_init(&mScaleMutex, NULL);
+    pthread_mutex_init(&mFilterMutex, NULL);
+    pthread_mutex_init(&mMutex, NULL);
+    pthread_cond_init(&mCond, NULL);
+    pthread_cond_init(&mDoneCond, NULL);
+
+    SetPolicy(policy);
+
+    // create pipe to wake the X event loop when an event is ready
+    if (pipe(mPipe) == 0) {
+        fcntl(mPipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(mPipe[1], F_SETFL, O_NONBLOCK);
+        if (data->the_app) {
+            mInputId = XtAppAddInput(data->the_app, mPipe[0], (XtPointer)XtInputReadMask,
+                                     (XtInputCallbackProc)InputProc, this);
+        }
+    } else {
+        mPipe[0] = mPipe[1] = -1;
+    }
+
+    // (events are finished on the analysis thread if this fails)
+    mThreadOK = (pthread_create(&mThread, NULL, ThreadProc, this) == 0);
+    if (!mThreadOK) {
+        Printf("Error creating event preparation thread\n");
+    }
+}
+
+// (must not be deleted until the X thread has stopped)
+PEventPreparer::~PEventPreparer()
+{
+    // stop the worker (waits for it to finish any event in progress)
+    if (mThreadOK) {
+        pthread_mutex_lock(&mMutex);
+        mQuit = 1;
+        pthread_cond_broadcast(&mCond);
+        pthread_mutex_unlock(&mMutex);
+        pthread_join(mThread, NULL);
+    }
+    if (mInputId) XtRemoveInput(mInputId);
+    if (mPipe[0] >= 0) {
+        close(mPipe[0]);
+        close(mPipe[1]);
+    }
+    Report();
+
+    // delete all events we still own
+    // (the displayed event must be recycled by clearEvent() before we are deleted)
+    AgedEvent *ev;
+    while ((ev = GetReady()) != NULL) {
+        deleteEvent(ev);
+    }
+    while (mNumJobs) {
+        deleteEvent(mJob[mJobHead]);
+        mJobHead = (mJobHead + 1) % kMaxPrefetch;
+        --mNumJobs;
+    }
+    while (mReturnHead != mReturnTail) {
+        deleteEvent(mReturn[mReturnHead++ % kMaxReturn]);
+    }
+    while (mFree) {
+        ev = mFree;
+        mFree = ev->next;
+        deleteEvent(ev);
+    }
+    pthread_mutex_destroy(&mScaleMutex);
+    pthread_mutex_destroy(&mFilterMutex);
+    pthread_cond_destroy(&mDoneCond);
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mMutex);
+}
+
+void PEventPreparer::SetPolicy(int policy)
+{
+    if ((unsigned)policy >= kNumSubmitPolicies) policy = kSubmitBlock;
+    mPolicy = policy;
+}
+
+// Submit - copy an event and pass it to the worker to prepare for display
+// - called from the analysis thread
+// - the event source is not needed after we return
+// - events accepted by the filter are written to the recorder (if not NULL),
+//   even if they are then dropped by the submit policy
+// - returns zero if the event was rejected by the filter or dropped
+int PEventPreparer::Submit(PEventSource *source, long run_number, PSnapshotWriter *recorder)
+{
+    ++mNumSubmitted;
+
+    // apply the event filter before doing anything else
+    if (mFiltered) {
+        pthread_mutex_lock(&mFilterMutex);
+        int ok = mFilter.Accept(source);
+        pthread_mutex_unlock(&mFilterMutex);
+        if (!ok) {
+            ++mNumRejected;
+            return(0);
+        }
+    }
+    ++mNumAccepted;
+
+    if (recorder) recorder->Write(source, run_number);
+
+    int policy = mPolicy;
+
+    if (mStopped) {
+        ++mNumDropped;
+        return(0);
+    }
+    if (policy != kSubmitLatest) {
+        // wait for room in the queue (counting events still with the worker),
+        // or drop the event now if we can't wait
+        pthread_mutex_lock(&mMutex);
+        while (mQueueTail - mQueueHead + mNumPending >= (unsigned)mDepth) {
+            if (policy == kSubmitQueue || mStopped) {
+                pthread_mutex_unlock(&mMutex);
+                ++mNumDropped;
+                return(0);
+            }
+            pthread_cond_wait(&mDoneCond, &mMutex);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+
+    AgedEvent *ev = GetFreeEvent();
+    Copy(ev, source, run_number);
+
+    if (!mThreadOK) {
+        // no worker, so finish the event here
+        Finish(ev);
+        Post(ev);
+        Wake();
+        return(1);
+    }
+    pthread_mutex_lock(&mMutex);
+    if (mNumJobs >= mDepth) {
+        // (latest-wins and the worker is behind, so drop the oldest job)
+        AgedEvent *old = mJob[mJobHead];
+        mJobHead = (mJobHead + 1) % kMaxPrefetch;
+        --mNumJobs;
+        --mNumPending;
+        ++mNumDropped;
+        old->next = mFree;
+        mFree = old;
+    }
+    mJob[(mJobHead + mNumJobs) % kMaxPrefetch] = ev;
+    ++mNumJobs;
+    ++mNumPending;
+    pthread_cond_signal(&mCond);
+    pthread_mutex_unlock(&mMutex);
+    return(1);
+}
+
+// WaitEmpty - wait until all posted events have been taken for display
+// - called from the analysis thread
+void PEventPreparer::WaitEmpty()
+{
+    pthread_mutex_lock(&mMutex);
+    while (!mStopped && (mNumPending || GetNumReady())) {
+        pthread_cond_wait(&mDoneCond, &mMutex);
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+// GetReady - get the next event to display (NULL if none)
+// - called from the X thread
+// - the event is displayed with displayEvent(), which takes a reference to it
+AgedEvent *PEventPreparer::GetReady()
+{
+    AgedEvent *ev = NULL;
+    if (mQueueHead != mQueueTail) {
+        ev = mQueue[mQueueHead % kMaxPrefetch];
+        ++mQueueHead;
+    } else {
+        ev = mLatest.exchange(NULL);
+    }
+    if (ev) {
+        ++mNumDisplayed;
+        SignalDone();
+    }
+    return(ev);
+}
+
+// Recycle - return an event for reuse by the analysis thread
+// - called from the X thread
+void PEventPreparer::Recycle(AgedEvent *ev)
+{
+    if (mReturnTail - mReturnHead < (unsigned)kMaxReturn) {
+        mReturn[mReturnTail % kMaxReturn] = ev;
+        ++mReturnTail;
+    } else {
+        deleteEvent(ev);
+        --mNumEvents;
+    }
+}
+
+// SetScale - set the hit colour scale for subsequently prepared events
+// - called from the X thread
+void PEventPreparer::SetScale(HitScale *scale)
+{
+    pthread_mutex_lock(&mScaleMutex);
+    mScale = *scale;
+    pthread_mutex_unlock(&mScaleMutex);
+}
+
+// SetFilter - set the filter for subsequently submitted events
+// - called from the X thread
+// - resets the accepted/rejected counts
+void PEventPreparer::SetFilter(PEventFilter *filter)
+{
+    pthread_mutex_lock(&mFilterMutex);
+    mFilter = *filter;
+    mFiltered = !filter->IsEmpty();
+    mNumAccepted = 0;
+    mNumRejected = 0;
+    pthread_mutex_unlock(&mFilterMutex);
+}
+
+// Stop - stop accepting events (called when the display closes)
+void PEventPreparer::Stop()
+{
+    mStopped = 1;
+    SignalDone();
+}
+
+int PEventPreparer::GetNumReady()
+{
+    return((int)(mQueueTail - mQueueHead) + (mLatest.load() ? 1 : 0));
+}
+
+// Wake - wake the X event loop
+void PEventPreparer::Wake()
+{
+    if (mPipe[1] >= 0 && write(mPipe[1], "", 1) < 0) { }
+}
+
+void PEventPreparer::Report()
+{
+    Printf("%ld events submitted, %ld displayed, %ld dropped (%d event buffers)\n",
+           (long)mNumSubmitted, (long)mNumDisplayed, (long)mNumDropped, (int)mNumEvents);
+    if (mFiltered) {
+        Printf("Filter accepted %ld, rejected %ld\n", (long)mNumAccepted, (long)mNumRejected);
+    }
+}
+
+// get an event for the analysis thread to fill
+AgedEvent *PEventPreparer::GetFreeEvent()
+{
+    pthread_mutex_lock(&mMutex);
+    AgedEvent *ev = mFree;
+    if (ev) mFree = ev->next;
+    pthread_mutex_unlock(&mMutex);
+
+    if (!ev) {
+        if (mReturnHead != mReturnTail) {
+            ev = mReturn[mReturnHead % kMaxReturn];
+            ++mReturnHead;
+        } else {
+            ev = newEvent();
+            ev->owner = this;
+            ++mNumEvents;
+        }
+    }
+    resetEvent(ev);
+    return(ev);
+}
+
+// drop an event that will not be displayed (worker thread)
+void PEventPreparer::Drop(AgedEvent *ev)
+{
+    ++mNumDropped;
+    pthread_mutex_lock(&mMutex);
+    ev->next = mFree;
+    mFree = ev;
+    pthread_mutex_unlock(&mMutex);
+}
+
+// post a finished event for display (worker thread)
+void PEventPreparer::Post(AgedEvent *ev)
+{
+    // (use the latest-wins slot if the queue is somehow full after a policy change)
+    if (mPolicy == kSubmitLatest || mQueueTail - mQueueHead >= (unsigned)kMaxPrefetch) {
+        // replace any event that hasn't been picked up yet
+        AgedEvent *old = mLatest.exchange(ev);
+        if (old) Drop(old);
+    } else {
+        mQueue[mQueueTail % kMaxPrefetch] = ev;
+        ++mQueueTail;
+    }
+}
+
+// wake the analysis thread if it is waiting in Submit() or WaitEmpty()
+// - called after an event is taken for display or finished by the worker,
+//   and when the display is stopped
+// - the mutex is taken so the signal can't be lost between the waiter
+//   testing its condition and starting to wait
+void PEventPreparer::SignalDone()
+{
+    pthread_mutex_lock(&mMutex);
+    pthread_cond_broadcast(&mDoneCond);
+    pthread_mutex_unlock(&mMutex);
+}
+
+void *PEventPreparer::ThreadProc(void *arg)
+{
+    ((PEventPreparer *)arg)->Run();
+    return(NULL);
+}
+
+// worker thread main loop
+void PEventPreparer::Run()
+{
+    pthread_mutex_lock(&mMutex);
+    for (;;) {
+        while (!mNumJobs && !mQuit) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        if (mQuit) break;
+        AgedEvent *ev = mJob[mJobHead];
+        mJobHead = (mJobHead + 1) % kMaxPrefetch;
+        --mNumJobs;
+        pthread_mutex_unlock(&mMutex);
+
+        Finish(ev);
+        Post(ev);
+        --mNumPending;
+        SignalDone();
+        Wake();
+
+        pthread_mutex_lock(&mMutex);
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+// callback when something is written to our pipe
+void PEventPreparer::InputProc(XtPointer client_data, int *source, XtInputId *id)
+{
+    PEventPreparer *prep = (PEventPreparer *)client_data;
+    char buff[64];
+    // drain the pipe
+    while (read(*source, buff, sizeof(buff)) > 0) { }
+    // break the main loop out of XtAppNextEvent() so it can show the event
+    wakeEventLoop(prep->mData);
+}
+
+// Copy - copy the raw data of an event from the source into an AgedEvent
+// - called from the analysis thread
+// - everything that doesn't need the source is left for Finish()
+void PEventPreparer::Copy(AgedEvent *ev, PEventSource *source, long run_number)
+{
+    int         i, j;
+    PArena      *arena = ev->arena;
+
+    ev->run_number = run_number;
+    ev->event_id   = source->GetEventID();
+    ev->num_hits   = source->GetNumHits();
+    ev->num_tracks = source->GetNumTracks();
+/*
+** Copy the space points into the hit store
+*/
+    int num = source->GetNumSpacePoints();
+    if (num > 0) {
+        SpacePoints *hits = &ev->hits;
+        if (allocHits(hits, num, arena, 0)) {
+            SourcePoint sp;
+            for (i=0; i<num; ++i) {
+                source->GetSpacePoint(i, &sp);
+                hits->x3[i] = sp.x / AG_SCALE;
+                hits->y3[i] = sp.y / AG_SCALE;
+                hits->z3[i] = sp.z / AG_SCALE;
+                hits->wire[i] = sp.wire;
+                hits->pad[i] = sp.pad;
+                hits->time[i] = sp.time;
+                hits->height[i] = sp.height;
+                hits->error[0][i] = sp.err[0];
+                hits->error[1][i] = sp.err[1];
+                hits->error[2][i] = sp.err[2];
+            }
+        }
+    }
+/*
+** Copy the waveforms for the hit wires and pads
+*/
+    if (ev->hits.num_nodes) {
+        SpacePoints *hits = &ev->hits;
+        char *wireUsed = arena->New<char>(NUM_AG_WIRES);
+        char *padUsed = arena->New<char>(NUM_AG_PADS);
+        if (wireUsed && padUsed) {
+            memset(wireUsed, 0, NUM_AG_WIRES);
+            memset(padUsed, 0, NUM_AG_PADS);
+            int nw = 0, np = 0;
+            for (i=0; i<hits->num_nodes; ++i) {
+                if ((unsigned)hits->wire[i] < NUM_AG_WIRES && !wireUsed[hits->wire[i]]) {
+                    wireUsed[hits->wire[i]] = 1;
+                    ++nw;
+                }
+                if ((unsigned)hits->pad[i] < NUM_AG_PADS && !padUsed[hits->pad[i]]) {
+                    padUsed[hits->pad[i]] = 1;
+                    ++np;
+                }
+            }
+            for (int type=0; type<kNumWaveformTypes; ++type) {
+                int nwf = source->GetNumWaveforms(type);
+                int max = (type == kWireWaveform ? nw : np);
+                char *used = (type == kWireWaveform ? wireUsed : padUsed);
+                unsigned nchan = (type == kWireWaveform ? NUM_AG_WIRES : NUM_AG_PADS);
+                if (nwf <= 0 || max <= 0) continue;
+                AgedWaveform *wfs = arena->New<AgedWaveform>(max);
+                if (!wfs) continue;
+                int n = 0;
+                for (j=0; j<nwf; ++j) {
+                    int chan = source->GetWaveformChannel(type, j);
+                    if ((unsigned)chan >= nchan || !used[chan]) continue;
+                    used[chan] = 0;     // (only take the first waveform for each channel)
+                    AgedWaveform *wf = wfs + n;
+                    wf->chan = chan;
+                    wf->num_samples = source->GetWaveformLength(type, j);
+                    wf->samples = arena->New<int>(wf->num_samples);
+                    if (!wf->samples) break;
+                    source->GetWaveform(type, j, wf->samples);
+                    if (++n >= max) break;
+                }
+                if (type == kWireWaveform) {
+                    ev->wire_wf = wfs;
+                    ev->num_wire_wf = n;
+                } else {
+                    ev->pad_wf = wfs;
+                    ev->num_pad_wf = n;
+                }
+            }
+        }
+    }
+/*
+** Copy the line and helix fits
+*/
+    num = source->GetNumLines();
+    if (num > 0 && (ev->src_lines = arena->New<SourceLine>(num)) != NULL) {
+        for (i=0; i<num; ++i) {
+            source->GetLine(i, ev->src_lines + i);
+        }
+        ev->num_lines = num;
+    }
+    num = source->GetNumHelices();
+    if (num > 0 && (ev->src_helices = arena->New<SourceHelix>(num)) != NULL) {
+        for (i=0; i<num; ++i) {
+            source->GetHelix(i, ev->src_helices + i);
+        }
+        ev->num_helices = num;
+    }
+/*
+** Copy the fit vertex
+*/
+    double vtx[3];
+    if (source->GetVertex(vtx)) {
+        ev->vertex.x = vtx[0];
+        ev->vertex.y = vtx[1];
+        ev->vertex.z = vtx[2];
+    }
+}
+
+// Finish - prepare a copied event for display
+// - called from the worker thread
+void PEventPreparer::Finish(AgedEvent *ev)
+{
+    int         i, j, num;
+    PArena      *arena = ev->arena;
+    SpacePoints *hits = &ev->hits;
+
+    pthread_mutex_lock(&mScaleMutex);
+    ev->scale = mScale;
+    pthread_mutex_unlock(&mScaleMutex);
+
+    if (hits->num_nodes) {
+/*
+** Clean up the hit values and calculate the hit colour indices
+*/
+        for (i=0; i<hits->num_nodes; ++i) {
+            if (isnan(hits->time[i])) hits->time[i] = -1;
+            if (isnan(hits->height[i])) hits->height[i] = -1;
+        }
+        calcHitColours(hits, &ev->scale);
+/*
+** Index the waveforms of the hit wires and pads
+*/
+        // flat indices from wire/pad number to waveform
+        // (kWaveWanted marks channels with hits, until their waveform is found)
+        ev->wire_index = arena->New<int>(NUM_AG_WIRES);
+        ev->pad_index = arena->New<int>(NUM_AG_PADS);
+        if (ev->wire_index && ev->pad_index) {
+            for (i=0; i<NUM_AG_WIRES; ++i) ev->wire_index[i] = kWaveNone;
+            for (i=0; i<NUM_AG_PADS; ++i) ev->pad_index[i] = kWaveNone;
+            for (i=0; i<hits->num_nodes; ++i) {
+                int wire = hits->wire[i];
+                int pad = hits->pad[i];
+                if ((unsigned)wire < NUM_AG_WIRES) ev->wire_index[wire] = kWaveWanted;
+                if ((unsigned)pad < NUM_AG_PADS) ev->pad_index[pad] = kWaveWanted;
+            }
+            // (only take the first waveform for each channel)
+            for (j=0; j<ev->num_wire_wf; ++j) {
+                int chan = ev->wire_wf[j].chan;
+                if ((unsigned)chan < NUM_AG_WIRES && ev->wire_index[chan] == kWaveWanted) {
+                    ev->wire_index[chan] = j;
+                }
+            }
+            for (j=0; j<ev->num_pad_wf; ++j) {
+                int chan = ev->pad_wf[j].chan;
+                if ((unsigned)chan < NUM_AG_PADS && ev->pad_index[chan] == kWaveWanted) {
+                    ev->pad_index[chan] = j;
+                }
+            }
+            // reset index for hit channels that had no waveform
+            for (i=0; i<hits->num_nodes; ++i) {
+                int wire = hits->wire[i];
+                int pad = hits->pad[i];
+                if ((unsigned)wire < NUM_AG_WIRES && ev->wire_index[wire] == kWaveWanted) {
+                    ev->wire_index[wire] = kWaveNone;
+                }
+                if ((unsigned)pad < NUM_AG_PADS && ev->pad_index[pad] == kWaveWanted) {
+                    ev->pad_index[pad] = kWaveNone;
+                }
+            }
+        } else {
+            ev->wire_index = ev->pad_index = NULL;
+        }
+    }
+/*
+** Calculate the straight line fit end points
+*/
+    num = ev->num_lines;
+    if (num > 0) {
+        ev->lines = arena->New<AgedLine>(num);
+        if (ev->lines) {
+            for (i=0; i<num; ++i) {
+                SourceLine *line = ev->src_lines + i;
+                AgedLine *al = ev->lines + i;
+                al->end[0].x = line->point[0] / AG_SCALE;
+                al->end[0].y = line->point[1] / AG_SCALE;
+                al->end[0].z = line->point[2] / AG_SCALE;
+                al->end[1].x = al->end[0].x + line->dir[0] * kFitLineLength;
+                al->end[1].y = al->end[0].y + line->dir[1] * kFitLineLength;
+                al->end[1].z = al->end[0].z + line->dir[2] * kFitLineLength;
+                al->status = line->status;
+            }
+        } else {
+            ev->num_lines = 0;
+        }
+    }
+/*
+** Tessellate the helix fits
+*/
+    num = ev->num_helices;
+    if (num > 0) {
+        ev->helices = arena->New<AgedHelix>(num);
+        float *x3 = arena->New<float>(num * kMaxHelixNodes);
+        float *y3 = arena->New<float>(num * kMaxHelixNodes);
+        float *z3 = arena->New<float>(num * kMaxHelixNodes);
+        if (ev->helices && x3 && y3 && z3) {
+            int k = 0;      // index of next free node
+            for (i=0; i<num; ++i) {
+                SourceHelix *helix = ev->src_helices + i;
+                AgedHelix *ah = ev->helices + i;
+                ah->status = helix->status;
+                ah->origin.x = helix->x0 / AG_SCALE;
+                ah->origin.y = helix->y0 / AG_SCALE;
+                ah->origin.z = helix->z0 / AG_SCALE;
+                ah->first = k;
+                ah->num_nodes = 0;
+                double r = 1 / (2 * helix->c);
+                double xc = -(r + helix->d) * sin(helix->phi0);
+                double yc =  (r + helix->d) * cos(helix->phi0);
+                double z0 = helix->z0;
+                double scl = helix->dir * PI / kMaxHelixNodes;
+                double rla = r * helix->lambda;
+                for (j=0; j<kMaxHelixNodes; ++j, ++k) {
+                    // one half turn (or less) of the helix
+                    double phi = helix->phi0 + j * scl;
+                    x3[k] = (xc + r * sin(phi)) / AG_SCALE;
+                    y3[k] = (yc - r * cos(phi)) / AG_SCALE;
+                    z3[k] = (z0 + rla * j * scl) / AG_SCALE;
+                    double r2sq = x3[k]*x3[k] + y3[k]*y3[k];
+                    if (r2sq > kMaxRSq) {
+                        if (!j) break;
+                        // clip line at maximum radius
+                        double r1 = sqrt(x3[k-1]*x3[k-1] + y3[k-1]*y3[k-1]);
+                        double f = (kMaxR - r1) / (sqrt(r2sq) - r1);
+                        x3[k] = x3[k-1] + f * (x3[k] - x3[k-1]);
+                        y3[k] = y3[k-1] + f * (y3[k] - y3[k-1]);
+                        z3[k] = z3[k-1] + f * (z3[k] - z3[k-1]);
+                        ah->num_nodes = j + 1;
+                        ++k;
+                        break;
+                    }
+                    ah->num_nodes = j + 1;
+                }
+            }
+            ev->num_helix_nodes = k;
+            ev->helix_x3 = x3;
+            ev->helix_y3 = y3;
+            ev->helix_z3 = z3;
+        } else {
+            ev->helices = NULL;
+            ev->num_helices = 0;
+        }
+    }
+}
@@ -0,0 +1,137 @@
+//==============================================================================
+// File:        PEventPreparer.h
+//
+// Description: Prepare events for display and pass them to the X thread
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PEventPreparer_h__
+#define __PEventPreparer_h__
+
+#include <atomic>
+#include <pthread.h>
+#include <X11/Intrinsic.h>
+#include "ImageData.h"
+#include "PEventSource.h"
+#include "PEventFilter.h"
+
+struct AgedEvent;
+class PSnapshotWriter;
+
+const int kMaxPrefetch = 64;            // maximum depth of prefetch queue
+const int kMaxReturn   = 256;           // size of ring for events returned for reuse
+
+// policy for events submitted when the display isn't ready for them
+enum ESubmitPolicy {
+    kSubmitBlock,                       // wait for room in the queue
+    kSubmitQueue,                       // drop the new event if the queue is full
+    kSubmitLatest,                      // replace any undisplayed event with the new one
+    kNumSubmitPolicies
+};
+
+/*
+** PEventPreparer - converts events into AgedEvents and posts them to the X thread
+**
+** Submit() is called from the analysis thread.  Events rejected by the filter
+** are discarded before any other work is done.  Accepted events are recorded
+** (if a recorder is given) whether or not the display can take them, so a
+** recording doesn't depend on how fast the display is.  Then the raw data is
+** copied from the PEventSource into the arena of an AgedEvent, which is handed
+** to a worker thread, and Submit() returns.  The worker finishes the event
+** (hit colours, waveform index and helix tessellation), then posts it to a
+** lock-free mailbox according to the submit policy: a bounded
+** single-producer/single-consumer queue, or a single latest-wins slot.  The
+** X thread takes events with GetReady() and gives them back with Recycle()
+** through a second ring, so it takes no locks on either path.  The X event
+** loop is woken through a pipe.
+*/
+class PEventPreparer {
+public:
+    PEventPreparer(ImageData *data, int depth, int policy);
+    ~PEventPreparer();
+
+    // called from the analysis thread
+    int             Submit(PEventSource *source, long run_number, PSnapshotWriter *recorder=NULL);
+    void            WaitEmpty();
+
+    // called from the X thread
+    AgedEvent     * GetReady();
+    void            Recycle(AgedEvent *ev);
+    void            SetScale(HitScale *scale);
+    void            SetFilter(PEventFilter *filter);
+    void            Stop();
+
+    void            SetPolicy(int policy);
+    int             GetPolicy()         { return mPolicy; }
+    int             IsStopped()         { return mStopped; }
+    int             GetNumReady();
+    long            GetNumSubmitted()   { return mNumSubmitted; }
+    long            GetNumDisplayed()   { return mNumDisplayed; }
+    long            GetNumDropped()     { return mNumDropped; }
+    long            GetNumAccepted()    { return mNumAccepted; }
+    long            GetNumRejected()    { return mNumRejected; }
+    int             IsFiltered()        { return mFiltered; }
+    void            Wake();
+    void            Report();
+
+private:
+    static void   * ThreadProc(void *arg);
+    static void     InputProc(XtPointer client_data, int *source, XtInputId *id);
+
+    void            Run();
+    void            Copy(AgedEvent *ev, PEventSource *source, long run_number);
+    void            Finish(AgedEvent *ev);
+    void            Post(AgedEvent *ev);
+    AgedEvent     * GetFreeEvent();
+    void            Drop(AgedEvent *ev);
+    void            SignalDone();
+
+    ImageData     * mData;              // data for window to wake when events are ready
+    int             mDepth;             // maximum number of events in queue
+    std::atomic<int> mPolicy;           // submit policy (ESubmitPolicy)
+    std::atomic<int> mStopped;          // set when the display will take no more events
+
+    // queue of events ready for display (written by analysis thread, read by X thread)
+    AgedEvent     * mQueue[kMaxPrefetch];
+    std::atomic<unsigned> mQueueHead;   // count of events taken from queue
+    std::atomic<unsigned> mQueueTail;   // count of events added to queue
+    std::atomic<AgedEvent*> mLatest;    // latest-wins mailbox slot
+
+    // events returned for reuse (written by X thread, read by analysis thread)
+    AgedEvent     * mReturn[kMaxReturn];
+    std::atomic<unsigned> mReturnHead;  // count of events reused
+    std::atomic<unsigned> mReturnTail;  // count of events returned
+
+    // events copied from the source and waiting for the worker (mutex)
+    pthread_t       mThread;            // worker thread
+    int             mThreadOK;          // true if worker thread was started
+    pthread_mutex_t mMutex;             // mutex for the job ring, free list and quit flag
+    pthread_cond_t  mCond;              // signals a new job (or quit) to the worker
+    pthread_cond_t  mDoneCond;          // signals the analysis thread that an event left the pipeline
+    int             mQuit;              // flag for worker thread to quit
+    AgedEvent     * mJob[kMaxPrefetch];
+    int             mJobHead;           // index of oldest job
+    int             mNumJobs;           // number of jobs waiting
+    std::atomic<int> mNumPending;       // events submitted but not yet posted for display
+
+    AgedEvent     * mFree;              // free list (mutex)
+    std::atomic<int> mNumEvents;        // total number of events allocated
+
+    pthread_mutex_t mScaleMutex;        // mutex for hit scale
+    HitScale        mScale;             // current hit scale (set by X thread)
+
+    pthread_mutex_t mFilterMutex;       // mutex for event filter
+    PEventFilter    mFilter;            // event filter (set by X thread)
+    std::atomic<int> mFiltered;         // true if the filter is not empty
+
+    std::atomic<long> mNumSubmitted;    // number of events submitted
+    std::atomic<long> mNumDisplayed;    // number of events taken for display
+    std::atomic<long> mNumDropped;      // number of events dropped
+    std::atomic<long> mNumAccepted;     // number of events accepted by the filter
+    std::atomic<long> mNumRejected;     // number of events rejected by the filter
+
+    int             mPipe[2];           // pipe to wake X event loop
+    XtInputId       mInputId;           // input ID for our end of the pipe
+};
+
+#endif // __PEventPreparer_h__
@@ -0,0 +1,81 @@
+//==============================================================================
+// File:        PEventSource.h
+//
+// Description: Interface for the source of an event to display
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PEventSource_h__
+#define __PEventSource_h__
+
+enum EWaveformType {
+    kWireWaveform,
+    kPadWaveform,
+    kNumWaveformTypes
+};
+
+// space point (units of mm)
+struct SourcePoint {
+    double      x, y, z;            // position
+    double      err[3];             // error in x, y, z
+    double      time;               // pulse time (may be NaN)
+    double      height;             // pulse height (may be NaN)
+    int         wire;               // wire number
+    int         pad;                // pad index
+};
+
+// straight line fit (units of mm)
+struct SourceLine {
+    double      point[3];           // point on line
+    double      dir[3];             // unit direction vector
+    int         status;             // fit status
+};
+
+// helix fit (units of mm)
+struct SourceHelix {
+    double      c;                  // curvature (1 / diameter)
+    double      phi0;               // azimuth of direction at point of closest approach
+    double      d;                  // distance of closest approach to z axis
+    double      lambda;             // dip (dz/ds)
+    double      x0, y0, z0;         // reference point
+    int         dir;                // direction to draw helix from reference point (+/-1)
+    int         status;             // fit status
+};
+
+/*
+** PEventSource - abstract source of the display-relevant parts of an event
+**
+** The display only sees events through this interface, so it can be driven
+** by the analysis (PRootEventSource), a snapshot file or an event generator
+** without any dependence on ROOT.  The source is only accessed from within
+** Aged::ShowEvent(), so it need only be valid until that returns.
+*/
+class PEventSource {
+public:
+    virtual         ~PEventSource() { }
+
+    virtual long    GetEventID() = 0;
+    virtual long    GetNumHits() = 0;
+    virtual long    GetNumTracks() = 0;
+    // returns zero if the source has no trigger information
+    virtual int     GetTriggerBits(unsigned *bits) = 0;
+
+    virtual int     GetNumSpacePoints() = 0;
+    virtual void    GetSpacePoint(int n, SourcePoint *sp) = 0;
+
+    virtual int     GetNumLines() = 0;
+    virtual void    GetLine(int n, SourceLine *line) = 0;
+
+    virtual int     GetNumHelices() = 0;
+    virtual void    GetHelix(int n, SourceHelix *helix) = 0;
+
+    // returns zero if there is no vertex
+    virtual int     GetVertex(double *xyz) = 0;
+
+    virtual int     GetNumWaveforms(int type) = 0;
+    virtual int     GetWaveformChannel(int type, int n) = 0;
+    virtual int     GetWaveformLength(int type, int n) = 0;
+    virtual void    GetWaveform(int type, int n, int *samples) = 0;
+};
+
+#endif // __PEventSource_h__
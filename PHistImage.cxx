@@ -15,6 +15,7 @@
 #include "PImageWindow.h"
 #include "ImageData.h"
 #include "PUtils.h"
+#include "PArena.h"
 
 #define HIST_MARGIN_BOTTOM          (25 * GetScaling())
 #define HIST_MARGIN_LEFT            (48 * GetScaling())
@@ -40,7 +41,10 @@ PHistImage::PHistImage(PImageWindow *owner, Widget canvas, int createCanvas)
     mYScale         = NULL;
     mIsLog          = 0;
     mHistogram      = NULL;
+    mHistBuff       = NULL;
+    mHistAlloc      = 0;
     mLabel          = NULL;
+    mLabelAlloc     = 0;
     mNumBins        = 0;
     mNumCols        = 0;
     mHistCols       = NULL;
@@ -85,7 +89,7 @@ PHistImage::~PHistImage()
     delete mYScale;
     
     // delete histogram, overlay, label string, and colours
-    delete [] mHistogram;
+    delete [] mHistBuff;
     delete [] mLabel;
     delete [] mHistCols;
 
@@ -102,6 +106,7 @@ PHistImage::~PHistImage()
 }
 
 // CreateData - create histogram data (can be used to delete data if numbins=0)
+// - the histogram memory is retained and re-used if it is large enough
 void PHistImage::CreateData(int numbins, int twoD)
 {
     int numPix;
@@ -112,11 +117,16 @@ void PHistImage::CreateData(int numbins, int twoD)
         numPix = 0;
     }
     if (numbins != mNumBins || numPix != mNumPix) {
-        delete [] mHistogram;
         mHistogram = NULL;
     }
     if (numbins && !mHistogram) {
-        mHistogram = new long[numbins * (numPix ? numPix : 1)];
+        long len = numbins * (long)(numPix ? numPix : 1);
+        if (len > mHistAlloc) {
+            delete [] mHistBuff;
+            mHistBuff = new long[len];
+            mHistAlloc = len;
+        }
+        mHistogram = mHistBuff;
         mNumBins = numbins;
         mNumPix = numPix;
         mNumTraces = 0;
@@ -157,8 +167,10 @@ long * PHistImage::AddOverlay()
             mOverlay[i-1] = NULL;
             mOverlayLabel[i-1] = NULL;
         }
+        // (the overlay takes ownership of our histogram memory)
         pt = mOverlay[0] = mHistogram;
-        mHistogram = NULL;
+        mHistogram = mHistBuff = NULL;
+        mHistAlloc = 0;
         if (mLabel) {
             char *lbl = mOverlayLabel[0] = new char[strlen(mLabel) + 1];
             if (lbl) strcpy(lbl, mLabel);
@@ -353,12 +365,18 @@ void PHistImage::SetScaleLimits(float min, float max, float min_rng)
 
 void PHistImage::SetLabel(char *str)
 {
-    if (mLabel) {
+    if (!str) {
         delete [] mLabel;
         mLabel = NULL;
-    }
-    if (str) {
-        mLabel = new char[strlen(str) + 1];
+        mLabelAlloc = 0;
+    } else {
+        int len = strlen(str) + 1;
+        // re-use the existing label string if it is long enough
+        if (len > mLabelAlloc) {
+            delete [] mLabel;
+            mLabel = new char[len];
+            mLabelAlloc = mLabel ? len : 0;
+        }
         if (mLabel) strcpy(mLabel, str);
     }
 }
@@ -1093,8 +1111,9 @@ void PHistImage::DrawSelf()
             if (mNumPix && mHistogram) {
                 // create array to hold line segments for each colour
                 unsigned ncols = (unsigned)mOwner->GetData()->num_cols;
-                XSegment **spp = new XSegment*[ncols];
-                int *nseg = new int[ncols];
+                PArena *arena = mOwner->GetData()->mFrameArena;
+                XSegment **spp = arena->New<XSegment*>(ncols);
+                int *nseg = arena->New<int>(ncols);
                 if (spp && nseg){
                     memset(spp, 0, ncols * sizeof(XSegment*));
                     memset(nseg, 0, ncols * sizeof(int));
@@ -1120,7 +1139,7 @@ void PHistImage::DrawSelf()
                             col = defCol;
                         }
                         if (!spp[col]) {
-                            spp[col] = new XSegment[kSegMax];
+                            spp[col] = arena->New<XSegment>(kSegMax);
                             if (!spp[col]) break;
                         }
                         if (nseg[col] >= kSegMax) {
@@ -1140,12 +1159,9 @@ void PHistImage::DrawSelf()
                         if (nseg[col]) {
                             SetForeground(FIRST_SCALE_COL + col);
                             DrawSegments(spp[col], nseg[col]);
-                            delete [] spp[col];
                         }
                     }
                 }
-                delete [] nseg;
-                delete [] spp;
             }
 
         } else if (mStyle == kHistStyleBars) {
@@ -1198,7 +1214,7 @@ void PHistImage::DrawSelf()
             
         } else {
             
-            XSegment *sp, *segments = new XSegment[nbin * 2];
+            XSegment *sp, *segments = mOwner->GetData()->mFrameArena->New<XSegment>(nbin * 2);
             if (!segments) {
                 printf("memory low\n");
                 return;
@@ -1261,7 +1277,6 @@ void PHistImage::DrawSelf()
                 }
                 DrawSegments(segments, sp-segments, 0);
             }
-            delete [] segments;
         }
     }
 /*
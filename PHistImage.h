@@ -124,6 +124,8 @@ protected:
     double          GetOverlaySpacing();
 
     long          * mHistogram;     // pointer to histogram array
+    long          * mHistBuff;      // allocated histogram memory (re-used by CreateData)
+    long            mHistAlloc;     // allocated length of histogram memory
     long          * mOverlay[kMaxOverlays];     // pointer to overlay array
     long            mOverscale;     // number of overscale entries
     long            mUnderscale;    // number of underscale entries
@@ -136,6 +138,7 @@ protected:
     int             mNumOverlays;   // number of overlays
     int             mNumCols;       // number of histogram colours
     char          * mLabel;         // histogram label
+    int             mLabelAlloc;    // allocated length of histogram label
     char          * mOverlayLabel[kMaxOverlays];
     PScale        * mXScale;        // pointer to X scale object
     PScale        * mYScale;        // pointer to Y scale object
@@ -147,7 +147,7 @@ void PHitInfoWindow::ClearEntries()
 /* Note: hits must be tranformed to appropriate projection BEFORE calling this routine */
 void PHitInfoWindow::UpdateSelf()
 {
-    HitInfo     *hi;
+    SpacePoints *hits = &mData->hits;
     char        buff[64];
     ImageData   *data = mData;
     int         num = data->cursor_hit; // current hit number near cursor
@@ -159,23 +159,22 @@ void PHitInfoWindow::UpdateSelf()
     if (num == -1 ) {
         ClearEntries();
     } else {
-        hi = data->hits.hit_info + num;
-        sprintf(buff,"%d of %d",num,data->hits.num_nodes);
+        sprintf(buff,"%d of %d",num,hits->num_nodes);
         hi_num.SetString(buff);
-        sprintf(buff,"%g",hi->time);
+        sprintf(buff,"%g",hits->time[num]);
         hi_time.SetString(buff);
-        sprintf(buff,"%g",hi->height);
+        sprintf(buff,"%g",hits->height[num]);
         hi_height.SetString(buff);
-        sprintf(buff,"%d",(int)hi->wire);
+        sprintf(buff,"%d",hits->wire[num]);
         hi_wire.SetString(buff);
-        sprintf(buff,"%d",(int)hi->pad);
+        sprintf(buff,"%d",hits->pad[num]);
         hi_pad.SetString(buff);
-        float *xyz = &(data->hits.nodes[num].x3);
+        float xyz[3] = { hits->x3[num], hits->y3[num], hits->z3[num] };
         for (int i=0; i<3; ++i) {
 #ifdef ANTI_ALIAS
-            sprintf(buff,"%.1f \xc2\xb1 %.1f",xyz[i] * AG_SCALE,hi->error[i]);
+            sprintf(buff,"%.1f \xc2\xb1 %.1f",xyz[i] * AG_SCALE,hits->error[i][num]);
 #else
-            sprintf(buff,"%.1f \xb1 %.1f",xyz[i] * AG_SCALE,hi->error[i]);
+            sprintf(buff,"%.1f \xb1 %.1f",xyz[i] * AG_SCALE,hits->error[i][num]);
 #endif
             hi_xyz[i].SetString(buff);
         }
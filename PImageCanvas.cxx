@@ -5,6 +5,7 @@
 //==============================================================================
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <X11/StringDefs.h>
 #include <Xm/DrawingA.h>
 #include "ImageData.h"
@@ -13,9 +14,11 @@
 #include "PHitInfoWindow.h"
 #include "PResourceManager.h"
 #include "PDrawXPixmap.h"
+#include "PDrawRaster.h"
 #include "PDrawPostscriptFile.h"
 #include "PMenu.h"
 #include "AgedWindow.h"
+#include "PArena.h"
 
 const short kPrintScaling       = 10;   // coordinate scaling for printed images
 const short kLabelClickMargin   = 8;
@@ -42,6 +45,8 @@ PImageCanvas::PImageCanvas(PImageWindow *owner, Widget canvas, EventMask eventMa
     mLabelText      = NULL;
     mLabelHeight    = 0;
     mDirty          = kDirtyPix;
+    mTrackCursor    = 0;
+    mNumCursorRects = 0;
     mTimer          = 0;
 
     SetCanvas(canvas);
@@ -132,6 +137,32 @@ void PImageCanvas::SetCursorForPos(int x, int y)
     }
 }
 
+// is this canvas in the list of canvases to rasterise on the client?
+static int isRasterCanvas(const char *name)
+{
+    const char *list = PResourceManager::sResource.raster_canvases;
+    if (!list) return(0);
+    size_t len = strlen(name);
+    for (const char *pt=list; (pt=strstr(pt,name))!=NULL; pt+=len) {
+        if ((pt==list || strchr(" ,\t",pt[-1])) && (!pt[len] || strchr(" ,\t",pt[len]))) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+// create the drawable for a canvas
+// - uses a server pixmap if raster drawing isn't requested or supported
+static PDrawable *newDrawable(Widget canvas, GC gc, int raster)
+{
+    Display *dpy = XtDisplay(canvas);
+    int depth = DefaultDepthOfScreen(XtScreen(canvas));
+    if (raster && PDrawRaster::IsSupported(dpy, depth)) {
+        return(new PDrawRaster(dpy, gc, depth, canvas));
+    }
+    return(new PDrawXPixmap(dpy, gc, depth, canvas));
+}
+
 void PImageCanvas::SetCanvas(Widget canvas)
 {
     mCanvas = canvas;
@@ -140,8 +171,7 @@ void PImageCanvas::SetCanvas(Widget canvas)
         mDpy = XtDisplay(canvas);
         
         if (mDrawable) delete mDrawable;
-        mDrawable = new PDrawXPixmap(mDpy, mOwner->GetData()->gc,
-                                     DefaultDepthOfScreen(XtScreen(canvas)), canvas);
+        mDrawable = newDrawable(canvas, mOwner->GetData()->gc, isRasterCanvas(XtName(canvas)));
         
         XtAddCallback(canvas, XmNexposeCallback, (XtCallbackProc)CanvasExposeProc, this);
         XtAddCallback(canvas, XmNresizeCallback, (XtCallbackProc)CanvasResizeProc, this);
@@ -194,7 +224,7 @@ void PImageCanvas::CanvasExposeProc(Widget w, PImageCanvas *anImage, XmDrawingAr
     {
         if (event->count == 0) {
             // call this routine after last copy to screen
-            anImage->AfterDrawing();
+            anImage->DrawCursor();
         }
     } else if (event->count == 0) { // only draw on last expose event
         // pixmap is dirty or unavailable -- draw the image from scratch
@@ -281,19 +311,78 @@ void PImageCanvas::Draw()
         if (!GetCanvasSize()) return;   // return if widget not realized
     }
     if (mDrawable->BeginDrawing(mCanvasWidth, mCanvasHeight)) {
+        // recycle scratch memory from the last draw
+        mOwner->GetData()->mFrameArena->Reset();
         Prepare();
         // set dirty pixmap flag too if we have arrived here without a pixmap
         if (!mDrawable->HasPixmap()) {
             mDirty |= kDirtyPix;
         }
-        DrawSelf();
-        mDrawable->EndDrawing();
-        // copy the image to the screen
-        mDrawable->CopyArea(0,0,mCanvasWidth,mCanvasHeight,XtWindow(mCanvas));
+        if (mDirty == kDirtyCursor && mTrackCursor) {
+            // only the cursor changed, so erase the old cursor by restoring
+            // just the areas it covered from the pixmap
+            mDrawable->EndDrawing();
+            for (int i=0; i<mNumCursorRects; ++i) {
+                XRectangle *r = mCursorRect + i;
+                mDrawable->CopyArea(r->x, r->y, r->width, r->height, XtWindow(mCanvas));
+            }
+        } else {
+            DrawSelf();
+            mDrawable->EndDrawing();
+            // copy the image to the screen
+            mDrawable->CopyArea(0,0,mCanvasWidth,mCanvasHeight,XtWindow(mCanvas));
+        }
         // reset all dirty flags since we have just successfully drawn ourself
         mDirty = 0;
-        AfterDrawing();     // call this after any drawing to screen
+        DrawCursor();       // call this after any drawing to screen
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// DrawCursor - call AfterDrawing() to draw the cursor on screen
+//
+void PImageCanvas::DrawCursor()
+{
+    mNumCursorRects = 0;
+    AfterDrawing();
+}
+
+//---------------------------------------------------------------------------------------
+// AddCursorRect - note an area drawn by AfterDrawing()
+//
+// - the area is restored from the pixmap to erase the cursor when it moves
+// - the rectangle is enlarged to allow for line widths and anti-aliasing
+// - images must set mTrackCursor to use this
+//
+void PImageCanvas::AddCursorRect(int x, int y, int w, int h)
+{
+    const int kMargin = 3;
+
+    x -= kMargin;
+    y -= kMargin;
+    w += 2 * kMargin;
+    h += 2 * kMargin;
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (w <= 0 || h <= 0) return;
+    if (mNumCursorRects >= kMaxCursorRects) {
+        // too many rectangles -- merge this one into the last
+        XRectangle *r = mCursorRect + kMaxCursorRects - 1;
+        int x2 = r->x + r->width;
+        int y2 = r->y + r->height;
+        if (x2 < x + w) x2 = x + w;
+        if (y2 < y + h) y2 = y + h;
+        if (x > r->x) x = r->x;
+        if (y > r->y) y = r->y;
+        w = x2 - x;
+        h = y2 - y;
+        mNumCursorRects = kMaxCursorRects - 1;
     }
+    XRectangle *r = mCursorRect + mNumCursorRects++;
+    r->x = x;
+    r->y = y;
+    r->width = w;
+    r->height = h;
 }
 
 //---------------------------------------------------------------------------------------
@@ -32,6 +32,7 @@ enum EDirtyFlags {
 };
 
 const int kTimerEvent = 999; // bogus event generated by our timer
+const int kMaxCursorRects = 4;  // maximum number of rectangles bounding the cursor
 
 class PImageWindow;
 struct Node;
@@ -69,6 +70,7 @@ public:
     virtual void    TransformHits()     { sLastTransformHits = this; }
 
     void            SetDirty(int flag=kDirtyNormal);
+    void            AddCursorRect(int x, int y, int w, int h);
     int             IsDirty()           { return mDirty;             }
     int             IsDirtyPix()        { return mDirty & kDirtyPix; }
     PImageWindow  * GetOwner()          { return mOwner;             }
@@ -104,6 +106,10 @@ public:
                                                               { mDrawable->DrawArc(cx,cy,rx,ry,ang1,ang2); }
     void            FillArc(int cx,int cy,int rx,int ry,float ang1=0.0,float ang2=360.0)
                                                               { mDrawable->FillArc(cx,cy,rx,ry,ang1,ang2); }
+    void            FillRectangles(XRectangle *rects, int num){ mDrawable->FillRectangles(rects,num); }
+    void            FillArcs(XArc *arcs, int num)             { mDrawable->FillArcs(arcs,num); }
+    void            FillMarkers(XPoint *points, int num, int size, int circles)
+                                                              { mDrawable->FillMarkers(points,num,size,circles); }
 protected:
     int             GetCanvasSize();
     
@@ -121,8 +127,13 @@ protected:
     XtIntervalId    mTimer;             // interval timer
     
     int             mDirty;             // flag set if need redrawing
+    int             mTrackCursor;       // set if AfterDrawing() calls AddCursorRect() for all it draws
 
 private:
+    void            DrawCursor();
+    
+    XRectangle      mCursorRect[kMaxCursorRects];   // areas drawn by the last AfterDrawing()
+    int             mNumCursorRects;    // number of cursor rectangles
     Dimension       mCanvasWidth;       // full width of canvas (incl. label region)
     Dimension       mCanvasHeight;      // full height of canvas (incl. label region)
     
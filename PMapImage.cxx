@@ -13,6 +13,7 @@
 #include "AgedWindow.h"
 #include "menu.h"
 #include "colours.h"
+#include "PThreadPool.h"
 
 #define PROJ_HIT_SIZE               0.004       // hit size (relative to image size)
 #define CONE_SEGMENT_TOL2           (20 * 20)   // maximum cone segment length (pixels squared)
@@ -64,6 +65,7 @@ PMapImage::PMapImage(PImageWindow *owner, Widget canvas)
     mShapeOption    = data->wShapeOption;
     mProjType       = data->wProjType;
     mInvisibleHits  = 0;
+    mTrackCursor    = 1;
     
     SetProjection(mProjType);
     
@@ -387,27 +389,47 @@ void PMapImage::TransformHits()
 }
 
 
+struct ReMapArgs {
+    float         * vec;
+    float        (* rot)[3];
+    Projection    * pp;
+    SpacePoints   * hits;
+};
+
+// map a chunk of hits into this projection
+static void reMapHitChunk(void *arg, int begin, int end)
+{
+    ReMapArgs   *args = (ReMapArgs *)arg;
+    SpacePoints *hits = args->hits;
+    Node        n0, nod;
+
+    for (int i=begin; i<end; ++i) {
+        n0.x3 = hits->x3[i];
+        n0.y3 = hits->y3[i];
+        n0.z3 = hits->z3[i];
+        /* map 3D tube coordinates into coordinates for this projection */
+        ReMapProj(&n0, args->vec, args->rot, args->pp, &nod);
+        /* save 2-d coordinates */
+        hits->x[i] = nod.x;
+        hits->y[i] = nod.y;
+    }
+}
+
 void PMapImage::TransformHits(Vector3 vec, Matrix3 rot1)
 {
-    int     i,num;
-    HitInfo *hi;
-    Node    *n0, nod;
+    int     num;
     ImageData *data = mOwner->GetData();
+    SpacePoints *hits = &data->hits;
     
 #ifdef PRINT_DRAWS
     Printf(":transform map\n");
 #endif  
-    if ((num=data->hits.num_nodes) != 0) {
-
-        hi = data->hits.hit_info;
-        n0 = data->hits.nodes;
-
-        for (i=0; i<num; ++i,++n0,++hi) {
-            /* map 3D tube coordinates into coordinates for this projection */
-            ReMapProj( n0, vec, rot1, &mProj, &nod);
-            /* save 2-d coordinates */
-            n0->x = nod.x;
-            n0->y = nod.y;
+    if ((num=hits->num_nodes) != 0) {
+        ReMapArgs args = { vec, rot1, &mProj, hits };
+        if (data->mThreadPool) {
+            data->mThreadPool->Run(num, reMapHitChunk, &args);
+        } else {
+            reMapHitChunk(&args, 0, num);
         }
     }
     
@@ -576,8 +598,7 @@ void PMapImage::DrawSelf()
 
     ImageData   *data = mOwner->GetData();
     XSegment    segments[MAX_EDGES], *sp;
-    HitInfo     *hi;
-    Node        *n0;
+    SpacePoints *hits = &data->hits;
     int         i, j, k, loops, segs, num, num1, m, i1, i2;
     int         x, y=0, xcen, ycen, xscl, yscl;
     double      theta=0, thinc, fac;
@@ -942,24 +963,13 @@ Do_Proj_Elliptical:
 /*
 ** Draw hits
 */
-    if ((num=data->hits.num_nodes) != 0) {
-        int d1, d2;
-        hi = data->hits.hit_info;
-        n0 = data->hits.nodes;
+    if ((num=hits->num_nodes) != 0) {
+        int d1;
         float scale = mProj.xscl * PROJ_HIT_SIZE * data->hit_size;
 
         d1 = (int)scale;
         if (d1 < 1) d1 = 1;
-        d2 = d1 * 2 + 1;
-        for (i=0; i<num; ++i,++n0,++hi) {
-            if (hi->flags & bit_mask) continue; /* only consider unmasked hits */
-            SetForeground(NUM_COLOURS + hi->hit_val);
-            if (mShapeOption == IDM_HIT_SQUARE) {
-                FillRectangle(n0->x-d1, n0->y-d1,d2,d2);
-            } else {
-                FillArc(n0->x, n0->y, d1, d1);
-            }
-        }
+        DrawHits(bit_mask, d1, mShapeOption != IDM_HIT_SQUARE);
     }
 }
 
@@ -969,9 +979,10 @@ void PMapImage::AfterDrawing()
     ImageData   *data = mOwner->GetData();
     int num = data->hits.num_nodes;
     int i = data->cursor_hit;
-    if (i >= 0 && i < num && !(data->hits.hit_info[i].flags & HiddenHitMask())) {
+    if (i >= 0 && i < num && !(data->hits.hit_flags[i] & HiddenHitMask())) {
         // remap only the node for this single hit
-        Node n0 = data->hits.nodes[i];
+        Node n0;
+        getHitNode(&data->hits, i, &n0);
         ReMapProj(&n0, mVec, mRot1, &mProj, &n0);
         int d1, d2;
         float scale = mProj.xscl * PROJ_HIT_SIZE * data->hit_size;
@@ -985,6 +996,7 @@ void PMapImage::AfterDrawing()
             SetForeground(data->cursor_sticky ? SELECT_COL : CURSOR_COL);
             DrawArc(n0.x, n0.y, d1, d1);
         }
+        AddCursorRect(n0.x-d1-1, n0.y-d1-1, d2+2, d2+2);
     }
 }
 
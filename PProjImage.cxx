@@ -4,12 +4,15 @@
 // Copyright (c) 2017, Phil Harvey, Queen's University
 //==============================================================================
 #include <math.h>
+#include <string.h>
 #include "ImageData.h"
 #include "PProjImage.h"
 #include "PImageWindow.h"
 #include "PResourceManager.h"
 #include "PSpeaker.h"
 #include "menu.h"
+#include "camera.h"
+#include "PArena.h"
 
 int PProjImage::sButtonDown = 0;
 
@@ -20,6 +23,7 @@ PProjImage::PProjImage(PImageWindow *owner, Widget canvas, EventMask eventMask)
     mScaleProportional  = 1;
     mMarginPix          = 5;        // pixel margin
     mMarginFactor       = 1;
+    memset(&mProj, 0, sizeof(mProj));
     mProj.proj_type     = -1;
     mImageSizeX         = 1.0;
     mImageSizeY         = 1.0;
@@ -138,6 +142,7 @@ void PProjImage::DrawAngles(int horiz,int angleFlags)
 void PProjImage::SetToHome(int n)
 {
     matrixIdent(mProj.rot);
+    cameraSetRotation(&mProj, mProj.rot);
     
     mProj.proj_max      = 1e10;
     mProj.proj_screen   = -1.0;
@@ -171,6 +176,157 @@ long PProjImage::HiddenHitMask()
     return(mInvisibleHits | mOwner->GetData()->bit_mask);
 }
 
+/*
+** Decimate a list of hit indices to one representative per cell of a
+** screen-space grid with the specified cell size
+** - returns the new number of hits in the list
+** - the representative is the hit with the highest colour index (the one
+**   that would be drawn on top)
+** - hits are dropped only if their whole marker (half the cell size
+**   around the hit) is off the image
+** - the list is left alone if it wouldn't save much drawing (ie. when zoomed in)
+*/
+int PProjImage::DecimateHits(int *list, int num, int cell)
+{
+    ImageData   *data = mOwner->GetData();
+    SpacePoints *hits = &data->hits;
+    short       *hit_val = hits->hit_val;
+    int         half = cell / 2;        // marker half-size
+    int         w = (mWidth + 2 * half + cell - 1) / cell;
+    int         h = (mHeight + 2 * half + cell - 1) / cell;
+    int         i, j, n, nocc = 0;
+
+    // don't bother unless the hits could fill a good part of the grid
+    if (w <= 0 || h <= 0 || num <= w * h / 4) return(num);
+
+    int *grid = data->mFrameArena->New<int>(w * h);
+    int *cells = data->mFrameArena->New<int>(num);
+    if (!grid || !cells) return(num);
+    memset(grid, -1, w * h * sizeof(int));
+
+    // find the representative of each occupied cell (by position in the list)
+    // (the grid extends by the marker half-size on each side of the image
+    // so markers partly over the edge are kept)
+    for (j=0; j<num; ++j) {
+        i = list[j];
+        int x = hits->x[i] + half;
+        int y = hits->y[i] + half;
+        if (x < 0 || y < 0 || x >= mWidth + 2 * half || y >= mHeight + 2 * half) {
+            cells[j] = -1;
+            continue;
+        }
+        int cx = x / cell;
+        int cy = y / cell;
+        int *gp = grid + (cells[j] = cy * w + cx);
+        if (*gp < 0) {
+            ++nocc;
+        } else if (hit_val[list[*gp]] > hit_val[i]) {
+            continue;
+        }
+        *gp = j;
+    }
+    if (nocc > num * 3 / 4) return(num);
+
+    for (j=0, n=0; j<num; ++j) {
+        if (cells[j] >= 0 && grid[cells[j]] == j) list[n++] = list[j];
+    }
+    return(n);
+}
+
+/*
+** Sort the hits that aren't masked by colour index
+** - returns the number of colours, with the hit indices in *order and the
+**   start of each colour in (*first)[0..ncols] (memory from the frame arena)
+** - the hits keep their original order within each colour
+** - if cell is non-zero, dense hits are decimated to one per cell of this size
+** - returns zero if there are no hits to draw
+*/
+int PProjImage::SortHits(long mask, int **order, int **first, int cell)
+{
+    ImageData   *data = mOwner->GetData();
+    SpacePoints *hits = &data->hits;
+    PArena      *arena = data->mFrameArena;
+    int         num = hits->num_nodes;
+    short       *hit_val = hits->hit_val;
+    short       *hit_flags = hits->hit_flags;
+    int         i, j, c, ncols = 0, ndraw = 0;
+
+    int *list = arena->New<int>(num);
+    if (!list) return(0);
+
+    // list the hits to draw
+    for (i=0; i<num; ++i) {
+        if ((hit_flags[i] & mask) || hit_val[i] < 0) continue;
+        if (hit_val[i] >= ncols) ncols = hit_val[i] + 1;
+        list[ndraw++] = i;
+    }
+    if (cell > 0 && ndraw) {
+        ndraw = DecimateHits(list, ndraw, cell);
+    }
+    if (!ndraw) return(0);
+
+    int *pos = arena->New<int>(ncols + 1);
+    int *idx = arena->New<int>(ndraw);
+    if (!pos || !idx) return(0);
+
+    // count the hits of each colour, then get the end index of each colour
+    memset(pos, 0, (ncols + 1) * sizeof(int));
+    for (j=0; j<ndraw; ++j) {
+        ++pos[hit_val[list[j]]];
+    }
+    for (c=1; c<=ncols; ++c) {
+        pos[c] += pos[c-1];
+    }
+    // fill in the indices from the end of each colour (leaving pos at the start)
+    for (j=ndraw-1; j>=0; --j) {
+        i = list[j];
+        idx[--pos[hit_val[i]]] = i;
+    }
+    *order = idx;
+    *first = pos;
+    return(ncols);
+}
+
+/*
+** Draw the hits that aren't masked as filled squares or circles
+** - size is the half-width of each hit in pixels
+** - each colour is drawn with a single call, so overlapping hits
+**   are drawn in colour order
+** - if hit_lod is set, dense hits are drawn only once per marker-sized cell
+**   on screen (but all hits are drawn when printing)
+*/
+void PProjImage::DrawHits(long mask, int size, int circles)
+{
+    ImageData   *data = mOwner->GetData();
+    SpacePoints *hits = &data->hits;
+    PArena      *arena = data->mFrameArena;
+    int         *order, *first;
+    int         cell = 0;
+
+    if (data->hit_lod && mDrawable->GetDeviceType() == kDeviceVideo) {
+        cell = size * 2 + 1;
+        if (cell < 2) cell = 2;
+    }
+    int ncols = SortHits(mask, &order, &first, cell);
+
+    if (!ncols) return;
+
+    XPoint *points = arena->New<XPoint>(first[ncols]);
+    if (!points) return;
+
+    for (int c=0; c<ncols; ++c) {
+        int n = first[c+1] - first[c];
+        if (!n) continue;
+        int *ip = order + first[c];
+        for (int j=0; j<n; ++j) {
+            points[j].x = hits->x[ip[j]];
+            points[j].y = hits->y[ip[j]];
+        }
+        SetForeground(FIRST_SCALE_COL + c);
+        FillMarkers(points, n, size, circles);
+    }
+}
+
 /* set data->cursor_hit to the index of the hit closest to the current cursor location */
 /* Returns non-zero if cursor hit changes */
 int PProjImage::FindNearestHit()
@@ -183,19 +339,17 @@ int PProjImage::FindNearestHit()
     
     int         num = -1;
     int         i,t,d,dx,dy;
-    Node        *node;
-    HitInfo     *hi;
+    SpacePoints *hits = &data->hits;
+    int         mask = data->bit_mask | mInvisibleHits;
     int         x = data->last_cur_x;
     int         y = data->last_cur_y;
 
-    if (data->hits.num_nodes) {
+    if (hits->num_nodes) {
         d    = 1000000;
-        node = data->hits.nodes;
-        hi   = data->hits.hit_info;
-        for (i=0; i<data->hits.num_nodes; ++i,++node, ++hi) {
-            if (hi->flags & (data->bit_mask | mInvisibleHits)) continue;    /* only consider unmasked ncds */
-            dx = x - node->x;
-            dy = y - node->y;
+        for (i=0; i<hits->num_nodes; ++i) {
+            if (hits->hit_flags[i] & mask) continue;    /* only consider unmasked ncds */
+            dx = x - hits->x[i];
+            dy = y - hits->y[i];
             t = dx*dx + dy*dy;
             if (t <= d) {           /* find closest node    */
                 num = i;
@@ -222,8 +376,7 @@ int PProjImage::HandleButton3(XEvent *event)
     if (event->type==ButtonPress && event->xbutton.button==Button3) {
         ImageData *data = mOwner->GetData();
         if (data->cursor_hit >= 0) {
-            HitInfo *hi = data->hits.hit_info + data->cursor_hit;
-            hi->flags ^= HIT_DISCARDED;     // toggle discarded flag
+            data->hits.hit_flags[data->cursor_hit] ^= HIT_DISCARDED;    // toggle discarded flag
             // inform listeners that the hit discarded flag has changed
             sendMessage(data, kMessageHitDiscarded,this);
             // redraw images
@@ -25,6 +25,7 @@ enum EAngleFlags {
 };
 
 struct Projection {
+    double      quat[4];            /* orientation quaternion (w,x,y,z) */
     Matrix3     rot;                /* rotation matrix */
     Matrix3     inv;                /* inverse rotation matrix */
     Vector3     pt;                 /* projection point */
@@ -40,6 +41,9 @@ struct Projection {
     float       theta;              /* projection theta rotation (optional) */
     float       phi;                /* projection phi rotation (optional) */
     float       gamma;              /* projection gamma rotation (optional) */
+    double      view[3][4];         /* fused view matrix (see cameraUpdateView) */
+    float       view_pt[3];         /* projection point the view matrix was made for */
+    float       view_max;           /* proj_max the view matrix was made for */
 };
 
 struct Node;
@@ -65,6 +69,9 @@ public:
 
     virtual int     FindNearestHit();
     long            HiddenHitMask();
+    int             DecimateHits(int *list, int num, int cell);
+    int             SortHits(long mask, int **order, int **first, int cell=0);
+    void            DrawHits(long mask, int size, int circles);
 
 protected:
     int             HandleButton3(XEvent *event);
@@ -50,6 +50,9 @@
 #include <math.h>
 #include <X11/StringDefs.h>
 #include "PResourceManager.h"
+#ifdef ANTI_ALIAS
+#include "PDrawXPixmap.h"
+#endif
 #include "PUtils.h"
 #include "openfile.h"
 #include "aged_version.h"
@@ -76,6 +79,24 @@ static XtResource sResourceList[] = {
         XtRString, (XtPointer)"42" },
  {"det_cols",   "DetCols",  XtRInt,   sizeof(int),  XtOffset(AgedResPtr,det_cols),
         XtRString, (XtPointer)"32" },
+ {"prefetch",   "Prefetch", XtRInt,   sizeof(int),  XtOffset(AgedResPtr,prefetch),
+        XtRString, (XtPointer)"4" },
+ {"submit_policy","SubmitPolicy",XtRInt,sizeof(int),XtOffset(AgedResPtr,submit_policy),
+        XtRString, (XtPointer)"0" },
+ {"history_events","HistoryEvents",XtRInt,sizeof(int),XtOffset(AgedResPtr,history_events),
+        XtRString, (XtPointer)"100" },
+ {"history_mb", "HistoryMB", XtRInt,  sizeof(int),  XtOffset(AgedResPtr,history_mb),
+        XtRString, (XtPointer)"256" },
+ {"threads",    "Threads",  XtRInt,   sizeof(int),  XtOffset(AgedResPtr,threads),
+        XtRString, (XtPointer)"0" },
+ {"parallel_hits","ParallelHits",XtRInt,sizeof(int),XtOffset(AgedResPtr,parallel_hits),
+        XtRString, (XtPointer)"20000" },
+ {"hit_lod",    "HitLOD",   XtRInt,   sizeof(int),  XtOffset(AgedResPtr,hit_lod),
+        XtRString, (XtPointer)"0" },
+ {"drag_ms",    "DragMS",   XtRInt,   sizeof(int),  XtOffset(AgedResPtr,drag_ms),
+        XtRString, (XtPointer)"16" },
+ {"raster_canvases","RasterCanvases",XtRString,sizeof(String),XtOffset(AgedResPtr,raster_canvases),
+        XtRString, (XtPointer)"" },
  {"proj_min",   "ProjMin",  XtRFloat, sizeof(float),XtOffset(AgedResPtr,proj.proj_min),
         XtRString, (XtPointer)"1.3"},
  {"proj_max",   "ProjMax",  XtRFloat, sizeof(float),XtOffset(AgedResPtr,proj.proj_max),
@@ -435,6 +456,7 @@ void PResourceManager::InitResources(Widget toplevel)
         sResource.xft_hist_font = XftFontOpenName(dpy, DefaultScreen(dpy), sResource.xft_hist_font_str); 
         sResource.xft_label_font = XftFontOpenName(dpy, DefaultScreen(dpy), sResource.xft_label_font_str); 
         sResource.xft_label_big_font = XftFontOpenName(dpy, DefaultScreen(dpy), sResource.xft_label_big_font_str); 
+        PDrawXPixmap::LoadXftColours();
 #endif
     }
 }
@@ -1194,6 +1216,10 @@ void PResourceManager::SetColour(int num, XColor *xcol)
 /* free allocated colours */
 void PResourceManager::FreeColours()
 {
+#ifdef ANTI_ALIAS
+    // free Xft colours for the old pixel values
+    PDrawXPixmap::FreeXftColours();
+#endif
     // deallocate grey colours if necessary
     FreeAllocatedColours(sResource.colour, NUM_COLOURS);
     // free scale colours
@@ -1214,6 +1240,9 @@ void PResourceManager::SetColours(int colourSet)
         CopyColours();
         AllocColours(sResource.num_cols,&sResource.scale_col,SCALE_UNDER, 7, 1, 1);
         AllocColours(sResource.det_cols,&sResource.det_col,VDARK_COL, 2, 0, 0);
+#ifdef ANTI_ALIAS
+        PDrawXPixmap::LoadXftColours();
+#endif
         
         sSpeaker->Speak(kMessageResourceColoursChanged);
     }
@@ -0,0 +1,156 @@
+//==============================================================================
+// File:        PRootEventSource.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include "PRootEventSource.h"
+#include "Aged.h"
+#include "TStoreEvent.hh"
+#include "TStoreLine.hh"
+#include "TStoreHelix.hh"
+#include "AgFlow.h"
+
+PRootEventSource::PRootEventSource(AgAnalysisFlow *anaFlow, AgSignalsFlow *sigFlow)
+{
+    mEvent = anaFlow ? anaFlow->fEvent : NULL;
+    mSigFlow = sigFlow;
+}
+
+long PRootEventSource::GetEventID()
+{
+    return(mEvent ? mEvent->GetEventNumber() : 0);
+}
+
+long PRootEventSource::GetNumHits()
+{
+    return(mEvent ? mEvent->GetNumberOfHits() : 0);
+}
+
+long PRootEventSource::GetNumTracks()
+{
+    return(mEvent ? mEvent->GetNumberOfTracks() : 0);
+}
+
+// (the trigger bits aren't available from the analysis flow)
+int PRootEventSource::GetTriggerBits(unsigned *bits)
+{
+    return(0);
+}
+
+int PRootEventSource::GetNumSpacePoints()
+{
+    if (!mEvent) return(0);
+    const TObjArray *points = mEvent->GetSpacePoints();
+    return(points ? points->GetEntries() : 0);
+}
+
+void PRootEventSource::GetSpacePoint(int n, SourcePoint *sp)
+{
+    TSpacePoint *spi = (TSpacePoint *)mEvent->GetSpacePoints()->At(n);
+    sp->x = spi->GetX();
+    sp->y = spi->GetY();
+    sp->z = spi->GetZ();
+    sp->err[0] = spi->GetErrX();
+    sp->err[1] = spi->GetErrY();
+    sp->err[2] = spi->GetErrZ();
+    sp->time = spi->GetTime();
+    sp->height = spi->GetHeight();
+    sp->wire = spi->GetWire();
+    sp->pad = spi->GetPad();
+}
+
+int PRootEventSource::GetNumLines()
+{
+    if (!mEvent) return(0);
+    const TObjArray *lines = mEvent->GetLineArray();
+    return(lines ? lines->GetEntries() : 0);
+}
+
+void PRootEventSource::GetLine(int n, SourceLine *line)
+{
+    TStoreLine *sl = (TStoreLine *)mEvent->GetLineArray()->At(n);
+    line->point[0] = sl->GetPoint()->X();
+    line->point[1] = sl->GetPoint()->Y();
+    line->point[2] = sl->GetPoint()->Z();
+    line->dir[0] = sl->GetDirection()->X();
+    line->dir[1] = sl->GetDirection()->Y();
+    line->dir[2] = sl->GetDirection()->Z();
+    line->status = sl->GetStatus();
+}
+
+int PRootEventSource::GetNumHelices()
+{
+    if (!mEvent) return(0);
+    const TObjArray *helices = mEvent->GetHelixArray();
+    return(helices ? helices->GetEntries() : 0);
+}
+
+void PRootEventSource::GetHelix(int n, SourceHelix *helix)
+{
+    TStoreHelix *sh = (TStoreHelix *)mEvent->GetHelixArray()->At(n);
+    helix->c = sh->GetC();
+    helix->phi0 = sh->GetPhi0();
+    helix->d = sh->GetD();
+    helix->lambda = sh->GetLambda();
+    helix->x0 = sh->GetX0();
+    helix->y0 = sh->GetY0();
+    helix->z0 = sh->GetZ0();
+    helix->status = sh->GetStatus();
+    // draw in the direction of the particle momentum
+    double rla = sh->GetLambda() / (2 * sh->GetC());
+    helix->dir = (sh->GetFBeta() * sh->GetMomentumV().Z() * rla > 0) ? -1 : 1;
+}
+
+int PRootEventSource::GetVertex(double *xyz)
+{
+    if (!mEvent) return(0);
+    xyz[0] = mEvent->GetVertex().X();
+    xyz[1] = mEvent->GetVertex().Y();
+    xyz[2] = mEvent->GetVertex().Z();
+    return(xyz[0] > -998);
+}
+
+int PRootEventSource::GetNumWaveforms(int type)
+{
+    if (!mSigFlow) return(0);
+    return(type == kWireWaveform ? mSigFlow->AWwf.size() : mSigFlow->PADwf.size());
+}
+
+// get the wire number or pad index of the specified waveform
+int PRootEventSource::GetWaveformChannel(int type, int n)
+{
+    if (type == kWireWaveform) return(mSigFlow->AWwf[n].i);
+    return(TPCBase::TPCBaseInstance()->SectorAndPad2Index(mSigFlow->PADwf[n].sec, mSigFlow->PADwf[n].i));
+}
+
+int PRootEventSource::GetWaveformLength(int type, int n)
+{
+    if (type == kWireWaveform) return(mSigFlow->AWwf[n].wf->size());
+    return(mSigFlow->PADwf[n].wf->size());
+}
+
+void PRootEventSource::GetWaveform(int type, int n, int *samples)
+{
+    if (type == kWireWaveform) {
+        const auto &wf = *mSigFlow->AWwf[n].wf;
+        for (size_t i=0; i<wf.size(); ++i) samples[i] = wf[i];
+    } else {
+        const auto &wf = *mSigFlow->PADwf[n].wf;
+        for (size_t i=0; i<wf.size(); ++i) samples[i] = wf[i];
+    }
+}
+
+//---------------------------------------------------------------------------------
+// Aged entry point for the analysis flow
+// (here so that Aged.cxx doesn't depend on ROOT)
+//
+
+// Show ALPHA-g event in the display
+// - called from the analysis thread (see Aged::ShowEvent(PEventSource*,long))
+void Aged::ShowEvent(AgAnalysisFlow* anaFlow, AgSignalsFlow* sigFlow, TARunInfo* runinfo)
+{
+    if (!anaFlow->fEvent) return;
+
+    PRootEventSource source(anaFlow, sigFlow);
+    ShowEvent(&source, runinfo->fRunNo);
+}
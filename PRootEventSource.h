@@ -0,0 +1,47 @@
+//==============================================================================
+// File:        PRootEventSource.h
+//
+// Description: Event source reading the agana analysis flow objects
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PRootEventSource_h__
+#define __PRootEventSource_h__
+
+#include "PEventSource.h"
+
+class AgAnalysisFlow;
+class AgSignalsFlow;
+class TStoreEvent;
+
+class PRootEventSource : public PEventSource {
+public:
+    PRootEventSource(AgAnalysisFlow *anaFlow, AgSignalsFlow *sigFlow);
+
+    virtual long    GetEventID();
+    virtual long    GetNumHits();
+    virtual long    GetNumTracks();
+    virtual int     GetTriggerBits(unsigned *bits);
+
+    virtual int     GetNumSpacePoints();
+    virtual void    GetSpacePoint(int n, SourcePoint *sp);
+
+    virtual int     GetNumLines();
+    virtual void    GetLine(int n, SourceLine *line);
+
+    virtual int     GetNumHelices();
+    virtual void    GetHelix(int n, SourceHelix *helix);
+
+    virtual int     GetVertex(double *xyz);
+
+    virtual int     GetNumWaveforms(int type);
+    virtual int     GetWaveformChannel(int type, int n);
+    virtual int     GetWaveformLength(int type, int n);
+    virtual void    GetWaveform(int type, int n, int *samples);
+
+private:
+    TStoreEvent   * mEvent;             // the analysis event
+    AgSignalsFlow * mSigFlow;           // the signals flow (may be NULL)
+};
+
+#endif // __PRootEventSource_h__
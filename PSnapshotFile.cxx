@@ -0,0 +1,480 @@
+//==============================================================================
+// File:        PSnapshotFile.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "PSnapshotFile.h"
+#include "CUtils.h"
+
+// round up to a multiple of 8 bytes
+static uint64_t align8(uint64_t n)
+{
+    return((n + 7) & ~(uint64_t)7);
+}
+
+// is this file offset suitably aligned for a record?
+static int isAligned8(uint64_t n)
+{
+    return((n & 7) == 0);
+}
+
+//---------------------------------------------------------------------------------
+// PSnapshotWriter
+//
+PSnapshotWriter::PSnapshotWriter(const char *filename)
+{
+    SnapFileHeader  hdr;
+
+    mOffset     = 0;
+    mTable      = NULL;
+    mNumEvents  = 0;
+    mMaxEvents  = 0;
+    mBuffer     = NULL;
+    mBufferSize = 0;
+    mFile = fopen(filename, "wb");
+    if (!mFile) {
+        Printf("Error creating snapshot file %s\n", filename);
+        return;
+    }
+    // write a header with no events (rewritten when the file is closed)
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic));
+    hdr.version = kSnapVersion;
+    hdr.header_size = sizeof(hdr);
+    if (!Put(&hdr, sizeof(hdr))) Close();
+}
+
+PSnapshotWriter::~PSnapshotWriter()
+{
+    Close();
+    free(mTable);
+    free(mBuffer);
+}
+
+// write data to the file
+int PSnapshotWriter::Put(const void *buff, size_t size)
+{
+    if (fwrite(buff, 1, size, mFile) != size) {
+        Printf("Error writing snapshot file\n");
+        return(0);
+    }
+    mOffset += size;
+    return(1);
+}
+
+// Write - append an event to the snapshot file
+// - returns zero on error
+int PSnapshotWriter::Write(PEventSource *source, long run_number)
+{
+    int         i, j, type;
+
+    if (!mFile) return(0);
+
+    // grow the offset table if necessary
+    if (mNumEvents >= mMaxEvents) {
+        long num = mMaxEvents ? mMaxEvents * 2 : 1024;
+        uint64_t *table = (uint64_t *)realloc(mTable, num * sizeof(uint64_t));
+        if (!table) {
+            Printf("Out of memory for snapshot table\n");
+            return(0);
+        }
+        mTable = table;
+        mMaxEvents = num;
+    }
+
+    // calculate the layout of the event record
+    int num_points = source->GetNumSpacePoints();
+    int num_lines = source->GetNumLines();
+    int num_helices = source->GetNumHelices();
+    int num_wf[kNumWaveformTypes];
+    int num_waves = 0;
+    uint64_t num_samples = 0;
+    for (type=0; type<kNumWaveformTypes; ++type) {
+        num_wf[type] = source->GetNumWaveforms(type);
+        num_waves += num_wf[type];
+        for (j=0; j<num_wf[type]; ++j) {
+            num_samples += source->GetWaveformLength(type, j);
+        }
+    }
+    uint64_t points_pos = sizeof(SnapEventHeader);
+    uint64_t lines_pos = points_pos + num_points * sizeof(SnapPoint);
+    uint64_t helices_pos = lines_pos + num_lines * sizeof(SnapLine);
+    uint64_t waves_pos = helices_pos + num_helices * sizeof(SnapHelix);
+    uint64_t samples_pos = waves_pos + num_waves * sizeof(SnapWave);
+    uint64_t size = align8(samples_pos + num_samples * sizeof(int16_t));
+
+    if (size > mBufferSize) {
+        char *buff = (char *)realloc(mBuffer, size);
+        if (!buff) {
+            Printf("Out of memory for snapshot event\n");
+            return(0);
+        }
+        mBuffer = buff;
+        mBufferSize = size;
+    }
+    memset(mBuffer, 0, size);
+
+    // fill in the event record
+    SnapEventHeader *ev = (SnapEventHeader *)mBuffer;
+    ev->event_id = source->GetEventID();
+    ev->run_number = run_number;
+    ev->num_hits = source->GetNumHits();
+    ev->num_tracks = source->GetNumTracks();
+    ev->num_points = num_points;
+    ev->num_lines = num_lines;
+    ev->num_helices = num_helices;
+    ev->has_vertex = source->GetVertex(ev->vertex);
+    unsigned trigger = 0;
+    ev->has_trigger = source->GetTriggerBits(&trigger);
+    ev->trigger = trigger;
+    for (type=0; type<kNumWaveformTypes; ++type) {
+        ev->num_wf[type] = num_wf[type];
+    }
+    ev->size = size;
+
+    SnapPoint *pt = (SnapPoint *)(mBuffer + points_pos);
+    SourcePoint sp;
+    for (i=0; i<num_points; ++i, ++pt) {
+        source->GetSpacePoint(i, &sp);
+        pt->x = sp.x;
+        pt->y = sp.y;
+        pt->z = sp.z;
+        for (j=0; j<3; ++j) pt->err[j] = sp.err[j];
+        pt->time = sp.time;
+        pt->height = sp.height;
+        pt->wire = sp.wire;
+        pt->pad = sp.pad;
+    }
+    SnapLine *ln = (SnapLine *)(mBuffer + lines_pos);
+    SourceLine line;
+    for (i=0; i<num_lines; ++i, ++ln) {
+        source->GetLine(i, &line);
+        for (j=0; j<3; ++j) {
+            ln->point[j] = line.point[j];
+            ln->dir[j] = line.dir[j];
+        }
+        ln->status = line.status;
+    }
+    SnapHelix *hx = (SnapHelix *)(mBuffer + helices_pos);
+    SourceHelix helix;
+    for (i=0; i<num_helices; ++i, ++hx) {
+        source->GetHelix(i, &helix);
+        hx->c = helix.c;
+        hx->phi0 = helix.phi0;
+        hx->d = helix.d;
+        hx->lambda = helix.lambda;
+        hx->x0 = helix.x0;
+        hx->y0 = helix.y0;
+        hx->z0 = helix.z0;
+        hx->dir = helix.dir;
+        hx->status = helix.status;
+    }
+    SnapWave *wv = (SnapWave *)(mBuffer + waves_pos);
+    uint64_t pos = samples_pos;
+    int *samples = NULL;
+    int max_samples = 0;
+    for (type=0; type<kNumWaveformTypes; ++type) {
+        for (j=0; j<num_wf[type]; ++j, ++wv) {
+            int n = source->GetWaveformLength(type, j);
+            if (n > max_samples) {
+                int *tmp = (int *)realloc(samples, n * sizeof(int));
+                if (!tmp) {
+                    n = 0;
+                } else {
+                    samples = tmp;
+                    max_samples = n;
+                }
+            }
+            wv->chan = source->GetWaveformChannel(type, j);
+            wv->num_samples = n;
+            wv->offset = pos;
+            if (!n) continue;
+            source->GetWaveform(type, j, samples);
+            // (samples are digitizer counts, so 16 bits is enough)
+            int16_t *out = (int16_t *)(mBuffer + pos);
+            for (i=0; i<n; ++i) {
+                int s = samples[i];
+                if (s > INT16_MAX) s = INT16_MAX;
+                if (s < INT16_MIN) s = INT16_MIN;
+                out[i] = (int16_t)s;
+            }
+            pos += n * sizeof(int16_t);
+        }
+    }
+    free(samples);
+
+    mTable[mNumEvents] = mOffset;
+    if (!Put(mBuffer, size)) {
+        // give up on this file (it will contain no events)
+        fclose(mFile);
+        mFile = NULL;
+        return(0);
+    }
+    ++mNumEvents;
+    return(1);
+}
+
+// Close - write the offset table and final header, and close the file
+// - returns zero on error
+int PSnapshotWriter::Close()
+{
+    SnapFileHeader  hdr;
+
+    if (!mFile) return(0);
+
+    uint64_t table_offset = mOffset;
+    int ok = (mNumEvents == 0 || Put(mTable, mNumEvents * sizeof(uint64_t)));
+    if (ok) {
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic));
+        hdr.version = kSnapVersion;
+        hdr.header_size = sizeof(hdr);
+        hdr.num_events = mNumEvents;
+        hdr.table_offset = table_offset;
+        ok = (fseek(mFile, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, mFile) == 1);
+        if (!ok) Printf("Error writing snapshot header\n");
+    }
+    if (fclose(mFile)) ok = 0;
+    mFile = NULL;
+    return(ok);
+}
+
+//---------------------------------------------------------------------------------
+// PSnapshotReader
+//
+PSnapshotReader::PSnapshotReader(const char *filename)
+{
+    struct stat st;
+
+    mMap        = NULL;
+    mMapSize    = 0;
+    mNumEvents  = 0;
+    mTable      = NULL;
+    mEvent      = NULL;
+    mPoints     = NULL;
+    mLines      = NULL;
+    mHelices    = NULL;
+    mWaves      = NULL;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        Printf("Error opening snapshot file %s\n", filename);
+        return;
+    }
+    if (fstat(fd, &st) || st.st_size < (off_t)sizeof(SnapFileHeader)) {
+        Printf("Invalid snapshot file %s\n", filename);
+        close(fd);
+        return;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        Printf("Error mapping snapshot file %s\n", filename);
+        return;
+    }
+    mMap = (char *)map;
+    mMapSize = st.st_size;
+
+    SnapFileHeader *hdr = (SnapFileHeader *)mMap;
+    if (memcmp(hdr->magic, SNAP_MAGIC, sizeof(hdr->magic)) || hdr->version != kSnapVersion ||
+        hdr->header_size != (int32_t)sizeof(SnapFileHeader) ||
+        hdr->table_offset > mMapSize || !isAligned8(hdr->table_offset) ||
+        hdr->num_events > (mMapSize - hdr->table_offset) / sizeof(uint64_t))
+    {
+        Printf("Invalid snapshot file %s\n", filename);
+        munmap(mMap, mMapSize);
+        mMap = NULL;
+        return;
+    }
+    mNumEvents = hdr->num_events;
+    mTable = (uint64_t *)(mMap + hdr->table_offset);
+}
+
+PSnapshotReader::~PSnapshotReader()
+{
+    if (mMap) munmap(mMap, mMapSize);
+}
+
+// SetEvent - select the event at the specified index in the file
+// - returns zero if the event is invalid
+int PSnapshotReader::SetEvent(long index)
+{
+    mEvent = NULL;
+    if (index < 0 || index >= mNumEvents) return(0);
+
+    // (the offset must be aligned before we may cast it to the header, and
+    // then the columns are aligned since their sizes are multiples of 8)
+    uint64_t offset = mTable[index];
+    if (offset > mMapSize || mMapSize - offset < sizeof(SnapEventHeader)) return(0);
+    if (!isAligned8(offset)) return(0);
+    SnapEventHeader *ev = (SnapEventHeader *)(mMap + offset);
+    if (ev->size > mMapSize - offset) return(0);
+    if (ev->num_points < 0 || ev->num_lines < 0 || ev->num_helices < 0 ||
+        ev->num_wf[kWireWaveform] < 0 || ev->num_wf[kPadWaveform] < 0) return(0);
+
+    uint64_t pos = sizeof(SnapEventHeader);
+    mPoints = (SnapPoint *)((char *)ev + pos);
+    pos += ev->num_points * (uint64_t)sizeof(SnapPoint);
+    mLines = (SnapLine *)((char *)ev + pos);
+    pos += ev->num_lines * (uint64_t)sizeof(SnapLine);
+    mHelices = (SnapHelix *)((char *)ev + pos);
+    pos += ev->num_helices * (uint64_t)sizeof(SnapHelix);
+    mWaves = (SnapWave *)((char *)ev + pos);
+    pos += (ev->num_wf[kWireWaveform] + (uint64_t)ev->num_wf[kPadWaveform]) * sizeof(SnapWave);
+    if (pos > ev->size) return(0);
+
+    mEvent = ev;
+    return(1);
+}
+
+// FindEvent - find the index of the event with the specified ID (-1 if not found)
+// - uses a binary search since events are normally in order within a run
+long PSnapshotReader::FindEvent(long event_id)
+{
+    long lo = 0, hi = mNumEvents - 1;
+    while (lo <= hi) {
+        long mid = (lo + hi) / 2;
+        if (!SetEvent(mid)) break;
+        if (mEvent->event_id == event_id) return(mid);
+        if (mEvent->event_id < event_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    // fall back to a linear search
+    for (long i=0; i<mNumEvents; ++i) {
+        if (SetEvent(i) && mEvent->event_id == event_id) return(i);
+    }
+    mEvent = NULL;
+    return(-1);
+}
+
+long PSnapshotReader::GetEventID()
+{
+    return(mEvent ? mEvent->event_id : 0);
+}
+
+long PSnapshotReader::GetNumHits()
+{
+    return(mEvent ? mEvent->num_hits : 0);
+}
+
+long PSnapshotReader::GetNumTracks()
+{
+    return(mEvent ? mEvent->num_tracks : 0);
+}
+
+int PSnapshotReader::GetTriggerBits(unsigned *bits)
+{
+    if (!mEvent || !mEvent->has_trigger) return(0);
+    *bits = mEvent->trigger;
+    return(1);
+}
+
+int PSnapshotReader::GetNumSpacePoints()
+{
+    return(mEvent ? mEvent->num_points : 0);
+}
+
+void PSnapshotReader::GetSpacePoint(int n, SourcePoint *sp)
+{
+    SnapPoint *pt = mPoints + n;
+    sp->x = pt->x;
+    sp->y = pt->y;
+    sp->z = pt->z;
+    sp->err[0] = pt->err[0];
+    sp->err[1] = pt->err[1];
+    sp->err[2] = pt->err[2];
+    sp->time = pt->time;
+    sp->height = pt->height;
+    sp->wire = pt->wire;
+    sp->pad = pt->pad;
+}
+
+int PSnapshotReader::GetNumLines()
+{
+    return(mEvent ? mEvent->num_lines : 0);
+}
+
+void PSnapshotReader::GetLine(int n, SourceLine *line)
+{
+    SnapLine *ln = mLines + n;
+    for (int i=0; i<3; ++i) {
+        line->point[i] = ln->point[i];
+        line->dir[i] = ln->dir[i];
+    }
+    line->status = ln->status;
+}
+
+int PSnapshotReader::GetNumHelices()
+{
+    return(mEvent ? mEvent->num_helices : 0);
+}
+
+void PSnapshotReader::GetHelix(int n, SourceHelix *helix)
+{
+    SnapHelix *hx = mHelices + n;
+    helix->c = hx->c;
+    helix->phi0 = hx->phi0;
+    helix->d = hx->d;
+    helix->lambda = hx->lambda;
+    helix->x0 = hx->x0;
+    helix->y0 = hx->y0;
+    helix->z0 = hx->z0;
+    helix->dir = hx->dir;
+    helix->status = hx->status;
+}
+
+int PSnapshotReader::GetVertex(double *xyz)
+{
+    if (!mEvent || !mEvent->has_vertex) return(0);
+    xyz[0] = mEvent->vertex[0];
+    xyz[1] = mEvent->vertex[1];
+    xyz[2] = mEvent->vertex[2];
+    return(1);
+}
+
+int PSnapshotReader::GetNumWaveforms(int type)
+{
+    return(mEvent ? mEvent->num_wf[type] : 0);
+}
+
+// get waveform directory entry (wire waveforms come first)
+SnapWave *PSnapshotReader::GetWave(int type, int n)
+{
+    if (type == kPadWaveform) n += mEvent->num_wf[kWireWaveform];
+    return(mWaves + n);
+}
+
+int PSnapshotReader::GetWaveformChannel(int type, int n)
+{
+    return(GetWave(type, n)->chan);
+}
+
+// get waveform length (zero if the samples lie outside the event record or are misaligned)
+int PSnapshotReader::GetWaveformLength(int type, int n)
+{
+    SnapWave *wv = GetWave(type, n);
+    if (wv->num_samples < 0 || wv->offset > mEvent->size || (wv->offset & 1) ||
+        (mEvent->size - wv->offset) / sizeof(int16_t) < (uint64_t)wv->num_samples)
+    {
+        return(0);
+    }
+    return(wv->num_samples);
+}
+
+void PSnapshotReader::GetWaveform(int type, int n, int *samples)
+{
+    int num = GetWaveformLength(type, n);
+    int16_t *in = (int16_t *)((char *)mEvent + GetWave(type, n)->offset);
+    for (int i=0; i<num; ++i) {
+        samples[i] = in[i];
+    }
+}
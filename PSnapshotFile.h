@@ -0,0 +1,165 @@
+//==============================================================================
+// File:        PSnapshotFile.h
+//
+// Description: Binary event snapshot files for replay without ROOT
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PSnapshotFile_h__
+#define __PSnapshotFile_h__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "PEventSource.h"
+
+/*
+** Snapshot file layout (native byte order, all records 8-byte aligned):
+**
+**  SnapFileHeader
+**  event records, each:
+**      SnapEventHeader
+**      SnapPoint   [num_points]
+**      SnapLine    [num_lines]
+**      SnapHelix   [num_helices]
+**      SnapWave    [num_wf[kWireWaveform] + num_wf[kPadWaveform]]
+**      int16_t samples for all waveforms (padded to 8 bytes)
+**  uint64_t offset table [num_events] (file offset of each event record)
+**
+** The header is rewritten with the event count and table offset when the
+** file is closed, so a file that was not closed properly has no events.
+*/
+#define SNAP_MAGIC          "AGEDSNAP"
+const int   kSnapVersion    = 2;
+
+struct SnapFileHeader {
+    char            magic[8];           // SNAP_MAGIC
+    int32_t         version;            // file version (kSnapVersion)
+    int32_t         header_size;        // size of this header
+    uint64_t        num_events;         // number of events in file
+    uint64_t        table_offset;       // file offset of event offset table
+};
+
+struct SnapEventHeader {
+    int64_t         event_id;           // event number
+    int64_t         run_number;         // run number
+    int64_t         num_hits;           // number of hits reported by the analysis
+    int64_t         num_tracks;         // number of tracks reported by the analysis
+    int32_t         num_points;         // number of space points
+    int32_t         num_lines;          // number of straight line fits
+    int32_t         num_helices;        // number of helix fits
+    int32_t         has_vertex;         // non-zero if vertex is valid
+    int32_t         num_wf[kNumWaveformTypes];  // number of waveforms of each type
+    int32_t         has_trigger;        // non-zero if trigger bits are valid
+    uint32_t        trigger;            // trigger bits
+    double          vertex[3];          // fit vertex (mm)
+    uint64_t        size;               // total size of event record
+};
+
+struct SnapPoint {
+    float           x, y, z;            // position (mm)
+    float           err[3];             // position errors (mm)
+    float           time;               // pulse time (may be NaN)
+    float           height;             // pulse height (may be NaN)
+    int32_t         wire;               // wire number
+    int32_t         pad;                // pad index
+};
+
+struct SnapLine {
+    float           point[3];           // point on line (mm)
+    float           dir[3];             // unit direction vector
+    int32_t         status;             // fit status
+    int32_t         spare;
+};
+
+struct SnapHelix {
+    double          c, phi0, d, lambda; // helix parameters
+    double          x0, y0, z0;         // reference point (mm)
+    int32_t         dir;                // direction to draw helix
+    int32_t         status;             // fit status
+};
+
+struct SnapWave {
+    int32_t         chan;               // wire number or pad index
+    int32_t         num_samples;        // number of samples
+    uint64_t        offset;             // offset of samples from start of event record
+};
+
+/*
+** PSnapshotWriter - records events from any source to a snapshot file
+*/
+class PSnapshotWriter {
+public:
+    PSnapshotWriter(const char *filename);
+    ~PSnapshotWriter();
+
+    int             IsOpen()            { return mFile != NULL; }
+    int             Write(PEventSource *source, long run_number);
+    int             Close();
+    long            GetNumEvents()      { return mNumEvents; }
+
+private:
+    int             Put(const void *buff, size_t size);
+
+    FILE          * mFile;              // output file
+    uint64_t        mOffset;            // current file offset
+    uint64_t      * mTable;             // event offset table
+    long            mNumEvents;         // number of events written
+    long            mMaxEvents;         // allocated size of offset table
+    char          * mBuffer;            // buffer for event record
+    size_t          mBufferSize;        // allocated size of event buffer
+};
+
+/*
+** PSnapshotReader - event source reading a memory-mapped snapshot file
+**
+** The file is mapped read-only and events are read in place, so any event
+** may be selected in constant time and nothing is deserialized beyond what
+** PEventPreparer asks for.
+*/
+class PSnapshotReader : public PEventSource {
+public:
+    PSnapshotReader(const char *filename);
+    virtual         ~PSnapshotReader();
+
+    int             IsOpen()            { return mMap != NULL; }
+    long            GetNumEvents()      { return mNumEvents; }
+    int             SetEvent(long index);
+    long            FindEvent(long event_id);
+    long            GetRunNumber()      { return mEvent ? mEvent->run_number : 0; }
+
+    virtual long    GetEventID();
+    virtual long    GetNumHits();
+    virtual long    GetNumTracks();
+    virtual int     GetTriggerBits(unsigned *bits);
+
+    virtual int     GetNumSpacePoints();
+    virtual void    GetSpacePoint(int n, SourcePoint *sp);
+
+    virtual int     GetNumLines();
+    virtual void    GetLine(int n, SourceLine *line);
+
+    virtual int     GetNumHelices();
+    virtual void    GetHelix(int n, SourceHelix *helix);
+
+    virtual int     GetVertex(double *xyz);
+
+    virtual int     GetNumWaveforms(int type);
+    virtual int     GetWaveformChannel(int type, int n);
+    virtual int     GetWaveformLength(int type, int n);
+    virtual void    GetWaveform(int type, int n, int *samples);
+
+private:
+    SnapWave      * GetWave(int type, int n);
+
+    char          * mMap;               // mapped file (NULL if not open)
+    size_t          mMapSize;           // size of mapped file
+    long            mNumEvents;         // number of events in file
+    uint64_t      * mTable;             // event offset table
+    SnapEventHeader * mEvent;           // current event (NULL if none)
+    SnapPoint     * mPoints;            // space points for current event
+    SnapLine      * mLines;             // lines for current event
+    SnapHelix     * mHelices;           // helices for current event
+    SnapWave      * mWaves;             // waveform directory for current event
+};
+
+#endif // __PSnapshotFile_h__
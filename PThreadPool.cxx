@@ -0,0 +1,177 @@
+//==============================================================================
+// File:        PThreadPool.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <unistd.h>
+#include "PThreadPool.h"
+#include "CUtils.h"
+
+const int kDefaultMinParallel = 20000; // default minimum number of hits to run in parallel
+const int kChunksPerThread    = 8;     // chunks per thread (granularity for stealing)
+
+//---------------------------------------------------------------------------------
+// PThreadPool constructor
+// - numThreads is the total number of threads including the caller (0 = one per core)
+// - minParallel is the smallest loop to run in parallel (0 = default)
+//
+PThreadPool::PThreadPool(int numThreads, int minParallel)
+{
+    if (numThreads <= 0) {
+        numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (numThreads > kMaxPoolThreads) numThreads = kMaxPoolThreads;
+    mNumThreads = numThreads > 1 ? numThreads - 1 : 0;
+    mMinParallel = minParallel > 0 ? minParallel : kDefaultMinParallel;
+    mFunc       = NULL;
+    mArg        = NULL;
+    mChunk      = 0;
+    mGeneration = 0;
+    mBusy       = 0;
+    mQuit       = 0;
+    pthread_mutex_init(&mMutex, NULL);
+    pthread_cond_init(&mStartCond, NULL);
+    pthread_cond_init(&mDoneCond, NULL);
+
+    mRange = new Range[mNumThreads + 1];
+    for (int i=0; i<=mNumThreads; ++i) {
+        pthread_mutex_init(&mRange[i].mutex, NULL);
+        mRange[i].next = mRange[i].end = 0;
+    }
+    mWorker = new Worker[mNumThreads];
+    for (int i=0; i<mNumThreads; ++i) {
+        mWorker[i].pool = this;
+        mWorker[i].index = i + 1;
+        if (pthread_create(&mWorker[i].thread, NULL, WorkerThread, mWorker + i)) {
+            Printf("Error creating worker thread (using %d threads)\n", i + 1);
+            mNumThreads = i;
+            break;
+        }
+    }
+}
+
+PThreadPool::~PThreadPool()
+{
+    pthread_mutex_lock(&mMutex);
+    mQuit = 1;
+    pthread_cond_broadcast(&mStartCond);
+    pthread_mutex_unlock(&mMutex);
+    for (int i=0; i<mNumThreads; ++i) {
+        pthread_join(mWorker[i].thread, NULL);
+    }
+    for (int i=0; i<=mNumThreads; ++i) {
+        pthread_mutex_destroy(&mRange[i].mutex);
+    }
+    pthread_mutex_destroy(&mMutex);
+    pthread_cond_destroy(&mStartCond);
+    pthread_cond_destroy(&mDoneCond);
+    delete [] mRange;
+    delete [] mWorker;
+}
+
+// Run - call func(arg,begin,end) for chunks covering [0,num), and wait until done
+void PThreadPool::Run(int num, ChunkFunc func, void *arg)
+{
+    if (num <= 0) return;
+
+    if (num < mMinParallel || !mNumThreads) {
+        func(arg, 0, num);
+        return;
+    }
+    int nranges = mNumThreads + 1;
+    mFunc = func;
+    mArg = arg;
+    mChunk = num / (nranges * kChunksPerThread);
+    if (mChunk < kMinPoolChunk) mChunk = kMinPoolChunk;
+
+    // give each thread an equal share of the loop to start with
+    for (int i=0; i<nranges; ++i) {
+        pthread_mutex_lock(&mRange[i].mutex);
+        mRange[i].next = (int)((long)num * i / nranges);
+        mRange[i].end  = (int)((long)num * (i + 1) / nranges);
+        pthread_mutex_unlock(&mRange[i].mutex);
+    }
+    pthread_mutex_lock(&mMutex);
+    ++mGeneration;
+    mBusy = mNumThreads;
+    pthread_cond_broadcast(&mStartCond);
+    pthread_mutex_unlock(&mMutex);
+
+    DoWork(0);
+
+    pthread_mutex_lock(&mMutex);
+    while (mBusy) {
+        pthread_cond_wait(&mDoneCond, &mMutex);
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+void *PThreadPool::WorkerThread(void *arg)
+{
+    Worker      *worker = (Worker *)arg;
+    PThreadPool *pool = worker->pool;
+    int         generation = 0;
+
+    pthread_mutex_lock(&pool->mMutex);
+    for (;;) {
+        while (!pool->mQuit && pool->mGeneration == generation) {
+            pthread_cond_wait(&pool->mStartCond, &pool->mMutex);
+        }
+        if (pool->mQuit) break;
+        generation = pool->mGeneration;
+        pthread_mutex_unlock(&pool->mMutex);
+
+        pool->DoWork(worker->index);
+
+        pthread_mutex_lock(&pool->mMutex);
+        if (--pool->mBusy == 0) {
+            pthread_cond_signal(&pool->mDoneCond);
+        }
+    }
+    pthread_mutex_unlock(&pool->mMutex);
+    return(NULL);
+}
+
+void PThreadPool::DoWork(int self)
+{
+    int begin, end;
+
+    while (GetChunk(self, &begin, &end)) {
+        mFunc(mArg, begin, end);
+    }
+}
+
+// get the next chunk of work, from our own range if possible, otherwise
+// steal it from the end of another range
+// - returns zero when there is no work left
+int PThreadPool::GetChunk(int self, int *begin, int *end)
+{
+    int     nranges = mNumThreads + 1;
+    Range   *range = mRange + self;
+
+    pthread_mutex_lock(&range->mutex);
+    if (range->next < range->end) {
+        *begin = range->next;
+        range->next += mChunk;
+        if (range->next > range->end) range->next = range->end;
+        *end = range->next;
+        pthread_mutex_unlock(&range->mutex);
+        return(1);
+    }
+    pthread_mutex_unlock(&range->mutex);
+
+    for (int i=1; i<nranges; ++i) {
+        range = mRange + (self + i) % nranges;
+        pthread_mutex_lock(&range->mutex);
+        if (range->next < range->end) {
+            *end = range->end;
+            range->end -= mChunk;
+            if (range->end < range->next) range->end = range->next;
+            *begin = range->end;
+            pthread_mutex_unlock(&range->mutex);
+            return(1);
+        }
+        pthread_mutex_unlock(&range->mutex);
+    }
+    return(0);
+}
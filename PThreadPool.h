@@ -0,0 +1,74 @@
+//==============================================================================
+// File:        PThreadPool.h
+//
+// Description: Pool of worker threads for data-parallel loops over the hits
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __PThreadPool_h__
+#define __PThreadPool_h__
+
+#include <pthread.h>
+
+const int kMaxPoolThreads   = 64;       // maximum number of worker threads
+const int kMinPoolChunk     = 256;      // minimum number of items in a chunk
+
+/*
+** PThreadPool - runs a loop over num items in chunks on all cores
+**
+** Run() splits [0,num) into one contiguous range per thread (the calling
+** thread takes part too), and each thread takes chunks from the front of
+** its own range.  A thread that runs out of work steals chunks from the
+** back of the other ranges, so an uneven load (eg. hits behind the viewer
+** taking the cheap path) still keeps every core busy to the end.
+** Loops of fewer than GetMinParallel() items are run serially in the
+** calling thread.  Run() may only be called from one thread at a time
+** (the X thread), and the function must not call Run() itself.
+*/
+class PThreadPool {
+public:
+    typedef void (*ChunkFunc)(void *arg, int begin, int end);
+
+    PThreadPool(int numThreads=0, int minParallel=0);
+    ~PThreadPool();
+
+    void            Run(int num, ChunkFunc func, void *arg);
+
+    int             GetNumThreads()     { return mNumThreads + 1; }
+    int             GetMinParallel()    { return mMinParallel; }
+    void            SetMinParallel(int num) { mMinParallel = num; }
+
+private:
+    struct Range {
+        pthread_mutex_t mutex;          // protects next and end
+        int             next;           // start of next chunk
+        int             end;            // end of range
+        char            pad[64];        // (keep ranges on separate cache lines)
+    };
+    struct Worker {
+        PThreadPool   * pool;           // pool we belong to
+        int             index;          // index of our range
+        pthread_t       thread;         // worker thread
+    };
+
+    static void   * WorkerThread(void *arg);
+    void            DoWork(int self);
+    int             GetChunk(int self, int *begin, int *end);
+
+    int             mNumThreads;        // number of worker threads
+    int             mMinParallel;       // minimum number of items to run in parallel
+    Range         * mRange;             // work ranges (one per thread, plus the caller)
+    Worker        * mWorker;            // worker threads
+    ChunkFunc       mFunc;              // function for current loop
+    void          * mArg;               // argument for current loop
+    int             mChunk;             // chunk size for current loop
+
+    pthread_mutex_t mMutex;             // protects variables below
+    pthread_cond_t  mStartCond;         // signalled when a loop starts
+    pthread_cond_t  mDoneCond;          // signalled when a worker is done
+    int             mGeneration;        // incremented for each loop
+    int             mBusy;              // number of workers still running
+    int             mQuit;              // flag to stop the workers
+};
+
+#endif // __PThreadPool_h__
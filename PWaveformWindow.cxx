@@ -17,7 +17,7 @@
 #include "ImageData.h"
 #include "PSpeaker.h"
 #include "CUtils.h"
-#include "AgFlow.h"
+#include "AgedEvent.h"
 
 const int   kDirtyEvent     = 0x02;
 const int   kDirtyAll       = 0x04;
@@ -358,25 +358,17 @@ void PWaveformWindow::UpdateSelf()
 
     if (IsDirty() & (kDirtyEvent | kDirtyAll)) {
 
-        HitInfo *hi = NULL;
-        void * wave[kMaxWaveformChannels] = { 0 };
+        AgedWaveform * wave[kMaxWaveformChannels] = { 0 };
+        int    wire = -1, pad = -1;
 
         if (hit_num >= 0) {
             // get waveforms for the space point at the cursor
-            hi = data->hits.hit_info + hit_num;
-            AgSignalsFlow *sigFlow = data->sigFlow;
-            for (auto it=sigFlow->AWwf.begin(); it!=sigFlow->AWwf.end(); ++it) {
-                if (it->i == hi->wire) {
-                    wave[kWireHist] = (void *)it->wf;
-                    break;
-                }
-            }
-            for (auto it=sigFlow->PADwf.begin(); it!=sigFlow->PADwf.end(); ++it) {
-                int pad = TPCBase::TPCBaseInstance()->SectorAndPad2Index(it->sec,it->i);
-                if (pad  == hi->pad) {
-                    wave[kPadHist] = (void *)it->wf;
-                    break;
-                }
+            wire = data->hits.wire[hit_num];
+            pad = data->hits.pad[hit_num];
+            AgedEvent *ev = data->mEvent;
+            if (ev) {
+                wave[kWireHist] = getWireWaveform(ev, wire);
+                wave[kPadHist] = getPadWaveform(ev, pad);
             }
         }
         // update data for displayed histograms
@@ -389,25 +381,13 @@ void PWaveformWindow::UpdateSelf()
                 }
             } else if (IsDirty() & kDirtyEvent) {
                 mHist[i]->SetDirty();
-                if (i == kWireHist) {
-                    const vector<int16_t> *wf = (const vector<int16_t> *)wave[0];
-                    mHist[i]->CreateData(wf->size());
-                    long *pt = mHist[i]->GetDataPt();
-                    if (pt) {
-                        mHist[i]->SetScaleLimits(0, wf->size(), 10);
-                        for (int i=0; i<wf->size(); ++i) {
-                            *pt++ = wf->at(i);
-                        }
-                    }
-                } else if (i == kPadHist) {
-                    const vector<int> *wf = (const vector<int> *)wave[1];
-                    mHist[i]->CreateData(wf->size());
-                    long *pt = mHist[i]->GetDataPt();
-                    if (pt) {
-                        mHist[i]->SetScaleLimits(0, wf->size(), 10);
-                        for (int i=0; i<wf->size(); ++i) {
-                            *pt++ = wf->at(i);
-                        }
+                AgedWaveform *wf = wave[i];
+                mHist[i]->CreateData(wf->num_samples);
+                long *pt = mHist[i]->GetDataPt();
+                if (pt) {
+                    mHist[i]->SetScaleLimits(0, wf->num_samples, 10);
+                    for (int j=0; j<wf->num_samples; ++j) {
+                        *pt++ = wf->samples[j];
                     }
                 }
             }
@@ -416,10 +396,10 @@ void PWaveformWindow::UpdateSelf()
             if (hit_num >= 0) {
                 switch (i) {
                     case kWireHist:
-                        sprintf(buff, "%s %d", hist_label[i], hi->wire);
+                        sprintf(buff, "%s %d", hist_label[i], wire);
                         break;
                     case kPadHist:
-                        sprintf(buff, "%s %d", hist_label[i], hi->pad);
+                        sprintf(buff, "%s %d", hist_label[i], pad);
                         break;
                 }
             }
@@ -0,0 +1,67 @@
+//==============================================================================
+// File:        agedgen.cxx
+//
+// Description: Stand-alone test driver showing generated events without ROOT
+//
+// Usage:       agedgen [-n hits] [-e events] [-p policy]
+//
+//              -n  number of space points per event (default 1000)
+//              -e  number of events to show (default 100)
+//              -p  submit policy: 0=block, 1=drop, 2=latest (default 0)
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include "Aged.h"
+#include "PEventGenerator.h"
+
+static void usage()
+{
+    fprintf(stderr, "Usage: agedgen [-n hits] [-e events] [-p policy]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int     numHits = 1000;
+    long    numEvents = 100;
+    int     policy = -1;
+
+    for (int i=1; i<argc; ++i) {
+        if (argv[i][0] != '-' || i + 1 >= argc) usage();
+        switch (argv[i][1]) {
+            case 'n':
+                numHits = atoi(argv[++i]);
+                break;
+            case 'e':
+                numEvents = atol(argv[++i]);
+                break;
+            case 'p':
+                policy = atoi(argv[++i]);
+                break;
+            default:
+                usage();
+                break;
+        }
+    }
+
+    Aged *aged = new Aged();
+    if (policy >= 0) aged->SetSubmitPolicy(policy);
+
+    // the generator is the analysis thread here
+    PEventGenerator gen(numHits);
+    for (long n=0; n<numEvents; ++n) {
+        gen.Next();
+        aged->ShowEvent(&gen, 0);
+    }
+    aged->Flush();
+
+    long submitted, displayed, dropped;
+    aged->GetCounts(&submitted, &displayed, &dropped);
+    printf("%d hits/event: %ld events submitted, %ld displayed, %ld dropped\n",
+           numHits, submitted, displayed, dropped);
+
+    delete aged;
+    return(0);
+}
@@ -0,0 +1,160 @@
+//==============================================================================
+// File:        camera.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#include <math.h>
+#include "camera.h"
+#include "PProjImage.h"
+
+// q = a * b
+static void quatMult(const double *a, const double *b, double *q)
+{
+    double t[4];
+    t[0] = a[0]*b[0] - a[1]*b[1] - a[2]*b[2] - a[3]*b[3];
+    t[1] = a[0]*b[1] + a[1]*b[0] + a[2]*b[3] - a[3]*b[2];
+    t[2] = a[0]*b[2] - a[1]*b[3] + a[2]*b[0] + a[3]*b[1];
+    t[3] = a[0]*b[3] + a[1]*b[2] - a[2]*b[1] + a[3]*b[0];
+    for (int i=0; i<4; ++i) q[i] = t[i];
+}
+
+// get quaternion for a right-handed rotation by angle about a unit axis
+static void quatAxis(const double *axis, double angle, double *q)
+{
+    double s = sin(angle / 2);
+    q[0] = cos(angle / 2);
+    q[1] = axis[0] * s;
+    q[2] = axis[1] * s;
+    q[3] = axis[2] * s;
+}
+
+// get the double-precision rotation matrix for the camera orientation
+static void quatMatrix(const double *q, double m[3][3])
+{
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+
+    m[0][0] = 1 - 2*(y*y + z*z);
+    m[0][1] = 2*(x*y - w*z);
+    m[0][2] = 2*(x*z + w*y);
+    m[1][0] = 2*(x*y + w*z);
+    m[1][1] = 1 - 2*(x*x + z*z);
+    m[1][2] = 2*(y*z - w*x);
+    m[2][0] = 2*(x*z - w*y);
+    m[2][1] = 2*(y*z + w*x);
+    m[2][2] = 1 - 2*(x*x + y*y);
+}
+
+// set the translation of the view matrix for the current projection point
+// - relative to the origin in z for orthographic views, since the
+//   projection point is effectively at infinity
+static void cameraSetViewPoint(Projection *pp)
+{
+    int     pers = pp->pt[2] < pp->proj_max;
+
+    for (int i=0; i<3; ++i) {
+        pp->view[i][3] = -(double)pp->pt[i];
+        pp->view_pt[i] = pp->pt[i];
+    }
+    if (!pers) pp->view[2][3] = 0;
+    pp->view_max = pp->proj_max;
+}
+
+// renormalise the quaternion and update the rotation and view matrices
+static void cameraUpdate(Projection *pp)
+{
+    double  *q = pp->quat;
+    double  m[3][3];
+    double  len = sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+
+    if (len) {
+        for (int i=0; i<4; ++i) q[i] /= len;
+    } else {
+        q[0] = 1;
+        q[1] = q[2] = q[3] = 0;
+    }
+    quatMatrix(q, m);
+    for (int i=0; i<3; ++i) {
+        for (int j=0; j<3; ++j) {
+            pp->rot[i][j] = m[i][j];
+            pp->inv[j][i] = m[i][j];
+            pp->view[i][j] = m[i][j];
+        }
+    }
+    cameraSetViewPoint(pp);
+}
+
+/*
+ * set the camera orientation from a rotation matrix
+ */
+void cameraSetRotation(Projection *pp, Matrix3 rot)
+{
+    double  *q = pp->quat;
+    double  tr = rot[0][0] + rot[1][1] + rot[2][2];
+
+    // (pick the largest component to avoid dividing by a small number)
+    if (tr > 0) {
+        double s = 2 * sqrt(tr + 1);
+        q[0] = s / 4;
+        q[1] = (rot[2][1] - rot[1][2]) / s;
+        q[2] = (rot[0][2] - rot[2][0]) / s;
+        q[3] = (rot[1][0] - rot[0][1]) / s;
+    } else if (rot[0][0] > rot[1][1] && rot[0][0] > rot[2][2]) {
+        double s = 2 * sqrt(1 + rot[0][0] - rot[1][1] - rot[2][2]);
+        q[0] = (rot[2][1] - rot[1][2]) / s;
+        q[1] = s / 4;
+        q[2] = (rot[0][1] + rot[1][0]) / s;
+        q[3] = (rot[0][2] + rot[2][0]) / s;
+    } else if (rot[1][1] > rot[2][2]) {
+        double s = 2 * sqrt(1 + rot[1][1] - rot[0][0] - rot[2][2]);
+        q[0] = (rot[0][2] - rot[2][0]) / s;
+        q[1] = (rot[0][1] + rot[1][0]) / s;
+        q[2] = s / 4;
+        q[3] = (rot[1][2] + rot[2][1]) / s;
+    } else {
+        double s = 2 * sqrt(1 + rot[2][2] - rot[0][0] - rot[1][1]);
+        q[0] = (rot[1][0] - rot[0][1]) / s;
+        q[1] = (rot[0][2] + rot[2][0]) / s;
+        q[2] = (rot[1][2] + rot[2][1]) / s;
+        q[3] = s / 4;
+    }
+    cameraUpdate(pp);
+}
+
+/*
+ * rotate the view by angle (right-handed) about a unit axis in screen coordinates
+ */
+void cameraRotate(Projection *pp, const double *axis, double angle)
+{
+    double  r[4];
+
+    quatAxis(axis, angle, r);
+    quatMult(r, pp->quat, pp->quat);
+    cameraUpdate(pp);
+}
+
+/*
+ * spin the detector by angle (right-handed) about its own z axis
+ */
+void cameraSpin(Projection *pp, double angle)
+{
+    static const double zaxis[3] = { 0, 0, 1 };
+    double  r[4];
+
+    quatAxis(zaxis, angle, r);
+    quatMult(pp->quat, r, pp->quat);
+    cameraUpdate(pp);
+}
+
+/*
+ * update the fused view matrix if the projection point has moved
+ * - the view transforms detector coordinates to rotated coordinates
+ *   relative to the projection point
+ */
+void cameraUpdateView(Projection *pp)
+{
+    if (pp->pt[0] != pp->view_pt[0] || pp->pt[1] != pp->view_pt[1] ||
+        pp->pt[2] != pp->view_pt[2] || pp->proj_max != pp->view_max)
+    {
+        cameraSetViewPoint(pp);
+    }
+}
@@ -0,0 +1,32 @@
+//==============================================================================
+// File:        camera.h
+//
+// Description: Viewing orientation of a 3-D projection
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __camera_h__
+#define __camera_h__
+
+#include "matrix.h"
+
+struct Projection;
+
+/*
+** The orientation of the camera is kept as a unit quaternion in double
+** precision (Projection.quat), and the rotation matrices (rot and inv) are
+** derived from it after every change.  Incremental rotations are composed
+** in the quaternion and renormalised, so the rotation stays orthonormal
+** however long the view is dragged around.
+**
+** The fused view matrix (Projection.view) is built from the quaternion when
+** the orientation changes, and its translation is updated by cameraUpdateView()
+** when the projection point has moved.  cameraUpdateView() must be called by
+** one thread before the view is used to project points from several threads.
+*/
+void    cameraSetRotation(Projection *pp, Matrix3 rot);
+void    cameraRotate(Projection *pp, const double *axis, double angle);
+void    cameraSpin(Projection *pp, double angle);
+void    cameraUpdateView(Projection *pp);
+
+#endif // __camera_h__
@@ -79,6 +79,7 @@ enum {
     IDM_HIT_SQUARE,
     IDM_HIT_CIRCLE,
     IDM_DATA_MENU,
+    IDM_NEW_DISPLAY,
 };
 
 // constants used to range check menu radio settings
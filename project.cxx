@@ -0,0 +1,355 @@
+//==============================================================================
+// File:        project.cxx
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+/*
+** Each point costs one product with the fused view matrix from the camera,
+** followed by the projection onto the screen.  The vector kernels do exactly
+** the same single-precision operations in the same order as the scalar code,
+** so they produce identical results.  The perspective kernels evaluate both
+** the in-front and behind cases for every point and select the result with a
+** mask instead of branching.
+*/
+#include <math.h>
+#include "project.h"
+#include "camera.h"
+#include "ImageData.h"
+#include "PProjImage.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROJECT_X86
+#include <immintrin.h>
+#define PROJECT_TARGET(isa)     __attribute__((target(isa)))
+#endif
+
+static const float kPlotMax = PLOT_MAX;
+
+// projection constants, converted once per call
+struct ProjParams {
+    float       view[3][4];         // fused rotation and translation
+    float       xcen, ycen;         // center of image
+    float       xscl, yscl;         // pixel radius of unit sphere
+    float       dist;               // distance from projection point to screen
+};
+
+typedef void (*ProjectFunc)(const ProjParams *pr, int num, const float *x3, const float *y3,
+                            const float *z3, float *xr, float *yr, float *zr,
+                            int *xp, int *yp, int *flags);
+
+/*
+ * perspective projection of a single translated point
+ * Returns: NODE_OUT if the point lies outside the plotting area, otherwise zero
+ */
+static inline int projectPerspective(const ProjParams *pr, float xt, float yt, float zt, int *xp, int *yp)
+{
+    float   f, x, y;
+    float   axt, ayt;
+
+    if (zt >= 0) {
+        axt = fabs(xt);
+        ayt = fabs(yt);
+        if (axt > ayt) f = kPlotMax/axt;
+        else  if (ayt) f = kPlotMax/ayt;
+        else {
+            f = kPlotMax;
+            xt = yt = 1;
+        }
+        *xp =   (int)(f * xt);
+        *yp = - (int)(f * yt);
+        return(NODE_OUT);
+    }
+/*
+** Distort image according to projection point while maintaining
+** a constant magnification for the projection screen.
+*/
+    x = pr->xcen + xt * pr->dist * pr->xscl / zt;
+    y = pr->ycen - yt * pr->dist * pr->yscl / zt;
+    axt = fabs(x);
+    ayt = fabs(y);
+    if (axt>kPlotMax || ayt>kPlotMax) {
+        if (axt > ayt) f = kPlotMax/axt;
+        else           f = kPlotMax/ayt;
+        *xp = (int)(f * x);
+        *yp = (int)(f * y);
+        return(NODE_OUT);
+    }
+    *xp = (int)(x);
+    *yp = (int)(y);
+    return(0);
+}
+
+template <int kPers>
+static void projectScalar(const ProjParams *pr, int num, const float *x3, const float *y3,
+                          const float *z3, float *xr, float *yr, float *zr,
+                          int *xp, int *yp, int *flags)
+{
+    const float (*m)[4] = pr->view;
+
+    for (int i=0; i<num; ++i) {
+        float x = x3[i];
+        float y = y3[i];
+        float z = z3[i];
+        float xt = xr[i] = x*m[0][0] + y*m[0][1] + z*m[0][2] + m[0][3];
+        float yt = yr[i] = x*m[1][0] + y*m[1][1] + z*m[1][2] + m[1][3];
+        float zt = zr[i] = x*m[2][0] + y*m[2][1] + z*m[2][2] + m[2][3];
+        int out = 0;
+        if (kPers) {
+            out = projectPerspective(pr, xt, yt, zt, xp + i, yp + i);
+        } else {
+            xp[i] = (int)(pr->xcen + pr->xscl * xt);
+            yp[i] = (int)(pr->ycen - pr->yscl * yt);
+        }
+        // reset NODE_OUT and NODE_HID flags
+        flags[i] = (flags[i] & ~(NODE_OUT | NODE_HID)) | out;
+    }
+}
+
+#ifdef PROJECT_X86
+
+//------------------------------------------------------------------------------
+// SSE2 kernel (4 points per pass)
+//
+PROJECT_TARGET("sse2")
+static inline __m128 selectPS(__m128 mask, __m128 a, __m128 b)
+{
+    return(_mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)));
+}
+
+PROJECT_TARGET("sse2")
+static inline __m128i selectSI(__m128 mask, __m128i a, __m128i b)
+{
+    __m128i m = _mm_castps_si128(mask);
+    return(_mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b)));
+}
+
+template <int kPers> PROJECT_TARGET("sse2")
+static void projectSSE(const ProjParams *pr, int num, const float *x3, const float *y3,
+                       const float *z3, float *xr, float *yr, float *zr,
+                       int *xp, int *yp, int *flags)
+{
+    const __m128  m00  = _mm_set1_ps(pr->view[0][0]);
+    const __m128  m01  = _mm_set1_ps(pr->view[0][1]);
+    const __m128  m02  = _mm_set1_ps(pr->view[0][2]);
+    const __m128  m03  = _mm_set1_ps(pr->view[0][3]);
+    const __m128  m10  = _mm_set1_ps(pr->view[1][0]);
+    const __m128  m11  = _mm_set1_ps(pr->view[1][1]);
+    const __m128  m12  = _mm_set1_ps(pr->view[1][2]);
+    const __m128  m13  = _mm_set1_ps(pr->view[1][3]);
+    const __m128  m20  = _mm_set1_ps(pr->view[2][0]);
+    const __m128  m21  = _mm_set1_ps(pr->view[2][1]);
+    const __m128  m22  = _mm_set1_ps(pr->view[2][2]);
+    const __m128  m23  = _mm_set1_ps(pr->view[2][3]);
+    const __m128  xcen = _mm_set1_ps(pr->xcen);
+    const __m128  ycen = _mm_set1_ps(pr->ycen);
+    const __m128  xscl = _mm_set1_ps(pr->xscl);
+    const __m128  yscl = _mm_set1_ps(pr->yscl);
+    const __m128  dist = _mm_set1_ps(pr->dist);
+    const __m128  pmax = _mm_set1_ps(kPlotMax);
+    const __m128  zero = _mm_setzero_ps();
+    const __m128  sign = _mm_set1_ps(-0.0f);
+    const __m128i imax = _mm_set1_epi32((int)kPlotMax);
+    const __m128i keep = _mm_set1_epi32(~(NODE_OUT | NODE_HID));
+    const __m128i nout = _mm_set1_epi32(NODE_OUT);
+    int i;
+
+    for (i=0; i+4<=num; i+=4) {
+        __m128 x = _mm_loadu_ps(x3 + i);
+        __m128 y = _mm_loadu_ps(y3 + i);
+        __m128 z = _mm_loadu_ps(z3 + i);
+        __m128 xt = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m01)), _mm_mul_ps(z, m02)), m03);
+        __m128 yt = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m10), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m12)), m13);
+        __m128 zt = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m20), _mm_mul_ps(y, m21)), _mm_mul_ps(z, m22)), m23);
+        _mm_storeu_ps(xr + i, xt);
+        _mm_storeu_ps(yr + i, yt);
+        _mm_storeu_ps(zr + i, zt);
+        __m128i ix, iy, out;
+        if (kPers) {
+            // behind the projection point: push out to the edge of the plot area
+            __m128 behind = _mm_cmpge_ps(zt, zero);
+            __m128 m = _mm_max_ps(_mm_andnot_ps(sign, xt), _mm_andnot_ps(sign, yt));
+            __m128 f = _mm_div_ps(pmax, m);
+            __m128 mzero = _mm_cmpeq_ps(m, zero);
+            __m128i bx = selectSI(mzero, imax, _mm_cvttps_epi32(_mm_mul_ps(f, xt)));
+            __m128i by = _mm_sub_epi32(_mm_setzero_si128(),
+                         selectSI(mzero, imax, _mm_cvttps_epi32(_mm_mul_ps(f, yt))));
+            // in front: perspective projection, clipped to the plot area
+            __m128 px = _mm_add_ps(xcen, _mm_div_ps(_mm_mul_ps(_mm_mul_ps(xt, dist), xscl), zt));
+            __m128 py = _mm_sub_ps(ycen, _mm_div_ps(_mm_mul_ps(_mm_mul_ps(yt, dist), yscl), zt));
+            __m128 apx = _mm_andnot_ps(sign, px);
+            __m128 apy = _mm_andnot_ps(sign, py);
+            __m128 clip = _mm_or_ps(_mm_cmpgt_ps(apx, pmax), _mm_cmpgt_ps(apy, pmax));
+            __m128 fc = _mm_div_ps(pmax, _mm_max_ps(apx, apy));
+            px = selectPS(clip, _mm_mul_ps(fc, px), px);
+            py = selectPS(clip, _mm_mul_ps(fc, py), py);
+            ix = selectSI(behind, bx, _mm_cvttps_epi32(px));
+            iy = selectSI(behind, by, _mm_cvttps_epi32(py));
+            out = _mm_and_si128(_mm_castps_si128(_mm_or_ps(behind, clip)), nout);
+        } else {
+            ix = _mm_cvttps_epi32(_mm_add_ps(xcen, _mm_mul_ps(xscl, xt)));
+            iy = _mm_cvttps_epi32(_mm_sub_ps(ycen, _mm_mul_ps(yscl, yt)));
+            out = _mm_setzero_si128();
+        }
+        __m128i fl = _mm_loadu_si128((__m128i *)(flags + i));
+        _mm_storeu_si128((__m128i *)(xp + i), ix);
+        _mm_storeu_si128((__m128i *)(yp + i), iy);
+        _mm_storeu_si128((__m128i *)(flags + i), _mm_or_si128(_mm_and_si128(fl, keep), out));
+    }
+    projectScalar<kPers>(pr, num - i, x3 + i, y3 + i, z3 + i, xr + i, yr + i, zr + i,
+                         xp + i, yp + i, flags + i);
+}
+
+//------------------------------------------------------------------------------
+// AVX2 kernel (8 points per pass)
+//
+PROJECT_TARGET("avx2")
+static inline __m256i selectSI256(__m256 mask, __m256i a, __m256i b)
+{
+    return(_mm256_blendv_epi8(b, a, _mm256_castps_si256(mask)));
+}
+
+template <int kPers> PROJECT_TARGET("avx2")
+static void projectAVX2(const ProjParams *pr, int num, const float *x3, const float *y3,
+                        const float *z3, float *xr, float *yr, float *zr,
+                        int *xp, int *yp, int *flags)
+{
+    const __m256  m00  = _mm256_set1_ps(pr->view[0][0]);
+    const __m256  m01  = _mm256_set1_ps(pr->view[0][1]);
+    const __m256  m02  = _mm256_set1_ps(pr->view[0][2]);
+    const __m256  m03  = _mm256_set1_ps(pr->view[0][3]);
+    const __m256  m10  = _mm256_set1_ps(pr->view[1][0]);
+    const __m256  m11  = _mm256_set1_ps(pr->view[1][1]);
+    const __m256  m12  = _mm256_set1_ps(pr->view[1][2]);
+    const __m256  m13  = _mm256_set1_ps(pr->view[1][3]);
+    const __m256  m20  = _mm256_set1_ps(pr->view[2][0]);
+    const __m256  m21  = _mm256_set1_ps(pr->view[2][1]);
+    const __m256  m22  = _mm256_set1_ps(pr->view[2][2]);
+    const __m256  m23  = _mm256_set1_ps(pr->view[2][3]);
+    const __m256  xcen = _mm256_set1_ps(pr->xcen);
+    const __m256  ycen = _mm256_set1_ps(pr->ycen);
+    const __m256  xscl = _mm256_set1_ps(pr->xscl);
+    const __m256  yscl = _mm256_set1_ps(pr->yscl);
+    const __m256  dist = _mm256_set1_ps(pr->dist);
+    const __m256  pmax = _mm256_set1_ps(kPlotMax);
+    const __m256  zero = _mm256_setzero_ps();
+    const __m256  sign = _mm256_set1_ps(-0.0f);
+    const __m256i imax = _mm256_set1_epi32((int)kPlotMax);
+    const __m256i keep = _mm256_set1_epi32(~(NODE_OUT | NODE_HID));
+    const __m256i nout = _mm256_set1_epi32(NODE_OUT);
+    int i;
+
+    for (i=0; i+8<=num; i+=8) {
+        __m256 x = _mm256_loadu_ps(x3 + i);
+        __m256 y = _mm256_loadu_ps(y3 + i);
+        __m256 z = _mm256_loadu_ps(z3 + i);
+        __m256 xt = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m00), _mm256_mul_ps(y, m01)), _mm256_mul_ps(z, m02)), m03);
+        __m256 yt = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m10), _mm256_mul_ps(y, m11)), _mm256_mul_ps(z, m12)), m13);
+        __m256 zt = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m20), _mm256_mul_ps(y, m21)), _mm256_mul_ps(z, m22)), m23);
+        _mm256_storeu_ps(xr + i, xt);
+        _mm256_storeu_ps(yr + i, yt);
+        _mm256_storeu_ps(zr + i, zt);
+        __m256i ix, iy, out;
+        if (kPers) {
+            // behind the projection point: push out to the edge of the plot area
+            __m256 behind = _mm256_cmp_ps(zt, zero, _CMP_GE_OQ);
+            __m256 m = _mm256_max_ps(_mm256_andnot_ps(sign, xt), _mm256_andnot_ps(sign, yt));
+            __m256 f = _mm256_div_ps(pmax, m);
+            __m256 mzero = _mm256_cmp_ps(m, zero, _CMP_EQ_OQ);
+            __m256i bx = selectSI256(mzero, imax, _mm256_cvttps_epi32(_mm256_mul_ps(f, xt)));
+            __m256i by = _mm256_sub_epi32(_mm256_setzero_si256(),
+                         selectSI256(mzero, imax, _mm256_cvttps_epi32(_mm256_mul_ps(f, yt))));
+            // in front: perspective projection, clipped to the plot area
+            __m256 px = _mm256_add_ps(xcen, _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(xt, dist), xscl), zt));
+            __m256 py = _mm256_sub_ps(ycen, _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(yt, dist), yscl), zt));
+            __m256 apx = _mm256_andnot_ps(sign, px);
+            __m256 apy = _mm256_andnot_ps(sign, py);
+            __m256 clip = _mm256_or_ps(_mm256_cmp_ps(apx, pmax, _CMP_GT_OQ),
+                                       _mm256_cmp_ps(apy, pmax, _CMP_GT_OQ));
+            __m256 fc = _mm256_div_ps(pmax, _mm256_max_ps(apx, apy));
+            px = _mm256_blendv_ps(px, _mm256_mul_ps(fc, px), clip);
+            py = _mm256_blendv_ps(py, _mm256_mul_ps(fc, py), clip);
+            ix = selectSI256(behind, bx, _mm256_cvttps_epi32(px));
+            iy = selectSI256(behind, by, _mm256_cvttps_epi32(py));
+            out = _mm256_and_si256(_mm256_castps_si256(_mm256_or_ps(behind, clip)), nout);
+        } else {
+            ix = _mm256_cvttps_epi32(_mm256_add_ps(xcen, _mm256_mul_ps(xscl, xt)));
+            iy = _mm256_cvttps_epi32(_mm256_sub_ps(ycen, _mm256_mul_ps(yscl, yt)));
+            out = _mm256_setzero_si256();
+        }
+        __m256i fl = _mm256_loadu_si256((__m256i *)(flags + i));
+        _mm256_storeu_si256((__m256i *)(xp + i), ix);
+        _mm256_storeu_si256((__m256i *)(yp + i), iy);
+        _mm256_storeu_si256((__m256i *)(flags + i), _mm256_or_si256(_mm256_and_si256(fl, keep), out));
+    }
+    projectScalar<kPers>(pr, num - i, x3 + i, y3 + i, z3 + i, xr + i, yr + i, zr + i,
+                         xp + i, yp + i, flags + i);
+}
+
+#endif // PROJECT_X86
+
+//------------------------------------------------------------------------------
+
+// get the best kernel supported by this CPU
+static int bestKernel()
+{
+#ifdef PROJECT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return(kProjectAVX2);
+    if (__builtin_cpu_supports("sse2")) return(kProjectSSE);
+#endif
+    return(kProjectScalar);
+}
+
+static int sKernel = kProjectAuto;
+
+int getProjectKernel()
+{
+    if (sKernel == kProjectAuto) sKernel = bestKernel();
+    return(sKernel);
+}
+
+// select the projection kernel (for testing)
+// - returns the kernel actually used, which may be less than requested
+int setProjectKernel(int kernel)
+{
+    int best = bestKernel();
+    if (kernel == kProjectAuto || kernel > best) kernel = best;
+    if (kernel < kProjectScalar) kernel = kProjectScalar;
+    sKernel = kernel;
+    return(kernel);
+}
+
+void projectPoints(Projection *pp, int num, const float *x3, const float *y3, const float *z3,
+                   float *xr, float *yr, float *zr, int *x, int *y, int *flags)
+{
+    ProjParams  pr;
+    ProjectFunc func;
+    int         pers = pp->pt[2] < pp->proj_max;
+
+    cameraUpdateView(pp);
+    for (int i=0; i<3; ++i) {
+        for (int j=0; j<4; ++j) {
+            pr.view[i][j] = pp->view[i][j];
+        }
+    }
+    pr.xcen = pp->xcen;
+    pr.ycen = pp->ycen;
+    pr.xscl = pp->xscl;
+    pr.yscl = pp->yscl;
+    pr.dist = pp->proj_screen - pp->pt[2];
+
+    switch (getProjectKernel()) {
+#ifdef PROJECT_X86
+        case kProjectAVX2:
+            func = pers ? projectAVX2<1> : projectAVX2<0>;
+            break;
+        case kProjectSSE:
+            func = pers ? projectSSE<1> : projectSSE<0>;
+            break;
+#endif
+        default:
+            func = pers ? projectScalar<1> : projectScalar<0>;
+            break;
+    }
+    func(&pr, num, x3, y3, z3, xr, yr, zr, x, y, flags);
+}
@@ -0,0 +1,34 @@
+//==============================================================================
+// File:        project.h
+//
+// Description: Projection of columnar 3-D coordinates onto the screen
+//
+// Copyright (c) 2017, Phil Harvey, Queen's University
+//==============================================================================
+#ifndef __project_h__
+#define __project_h__
+
+#define PLOT_MAX            8000.0          /* maximum value for x,y plot coords */
+
+struct Projection;
+
+enum EProjectKernel {
+    kProjectAuto = -1,                  // choose the best kernel for this CPU
+    kProjectScalar,                     // plain C
+    kProjectSSE,                        // 4 points at a time
+    kProjectAVX2                        // 8 points at a time
+};
+
+/*
+** Rotate and project num points from the x3,y3,z3 columns, writing the view
+** coordinates (xr,yr,zr, see cameraUpdateView()), screen coordinates (x,y)
+** and flags.
+** NODE_HID is reset and NODE_OUT is set for points off the plot area.
+** The vector kernels give the same results as the scalar code.
+*/
+void    projectPoints(Projection *pp, int num, const float *x3, const float *y3, const float *z3,
+                      float *xr, float *yr, float *zr, int *x, int *y, int *flags);
+int     getProjectKernel();
+int     setProjectKernel(int kernel);
+
+#endif // __project_h__